@@ -0,0 +1,196 @@
+/*
+ * Measures the BLZ compressor and decoder.
+ *
+ * Usage: blzbench [files...]
+ *
+ * Without files, a fixed set of generated inputs is used, so results
+ * can be compared between machines and between versions of the code.
+ *
+ * Only the parts of the BLZ interface that every version has are used.
+ * To measure an older version, configure with NCP_BENCH_BLZ_DIR pointing
+ * to a directory containing its blz.hpp and blz.cpp, for example:
+ *
+ *   mkdir old && git show <commit>:source/blz.hpp > old/blz.hpp
+ *   git show <commit>:source/blz.cpp > old/blz.cpp
+ *   cmake -DNCP_BUILD_BENCHMARKS=ON -DNCP_BENCH_BLZ_DIR=$PWD/old ...
+ * */
+
+#include "blz.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+using clk = std::chrono::steady_clock;
+
+struct Input
+{
+	std::string name;
+	std::vector<u8> data;
+};
+
+// Machine code is made of instructions built from a few fields, with sequences
+// repeated and some data in between. The engine's output is the same everywhere,
+// its distributions are not, so only its raw output is used.
+static std::vector<u8> makeCodeLike(std::size_t size, u32 seed)
+{
+	std::mt19937 rng(seed);
+
+	std::vector<u32> words;
+	words.reserve(size / 4 + 1);
+	while (words.size() * 4 < size)
+	{
+		u32 kind = rng() % 16;
+		if (kind < 9)
+		{
+			// Mostly unconditional, with one of a few opcodes, low registers and small immediates
+			u32 cond = rng() % 8 == 0 ? rng() % 15 : 0xE;
+			u32 opcode = rng() % 24;
+			u32 regs = ((rng() & 7) << 8) | ((rng() & 7) << 4) | (rng() & 7);
+			u32 imm = rng() % 4 == 0 ? rng() & 0xFF : rng() & 0xF;
+			words.push_back((cond << 28) | (opcode << 20) | (regs << 8) | imm);
+		}
+		else if (kind < 15 && words.size() >= 1024)
+		{
+			// A sequence seen shortly before
+			std::size_t start = words.size() - 1 - rng() % 1024;
+			std::size_t count = 1 + rng() % 8;
+			for (std::size_t i = 0; i < count; i++)
+				words.push_back(words[start + i]);
+		}
+		else
+		{
+			words.push_back(rng());
+		}
+	}
+
+	std::vector<u8> data(size);
+	std::memcpy(data.data(), words.data(), size);
+	return data;
+}
+
+static std::vector<Input> makeInputs()
+{
+	std::vector<Input> inputs;
+	inputs.push_back({ "overlay-200K", makeCodeLike(200000, 1) });
+	inputs.push_back({ "binary-1M", makeCodeLike(1000000, 2) });
+	inputs.push_back({ "arm9-4M", makeCodeLike(4 * 1024 * 1024, 3) });
+	inputs.push_back({ "zeros-500K", std::vector<u8>(500000, 0) });
+	return inputs;
+}
+
+static bool readInput(const char* path, Input& input)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	input.name = path;
+	input.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	return true;
+}
+
+// Runs func repeatedly for about a second, returns the best time of a run in seconds
+template<typename T>
+static double measure(T&& func)
+{
+	double best = 1e30;
+	double total = 0;
+	do
+	{
+		auto start = clk::now();
+		func();
+		double elapsed = std::chrono::duration<double>(clk::now() - start).count();
+		best = std::min(best, elapsed);
+		total += elapsed;
+	}
+	while (total < 1.0);
+	return best;
+}
+
+static void benchInput(const Input& input)
+{
+	const std::vector<u8>& data = input.data;
+	double size = double(data.size());
+
+	std::vector<u8> compressed;
+	double compressTime = measure([&](){
+		compressed = BLZ::compress(data);
+	});
+
+	std::printf("%-16s %9zu bytes  compress %8.2f ms %8.2f MB/s", input.name.c_str(), data.size(),
+		compressTime * 1e3, size / compressTime / 1e6);
+
+	if (compressed.empty())
+	{
+		std::printf("  does not shrink\n");
+		return;
+	}
+	std::printf("  ratio %5.1f%%", double(compressed.size()) * 100 / size);
+
+	bool valid;
+	try
+	{
+		valid = BLZ::uncompress(compressed) == data;
+	}
+	catch (const std::exception&)
+	{
+		valid = false;
+	}
+	if (!valid)
+	{
+		std::printf("  round trip FAILED\n");
+		return;
+	}
+
+	// Each run decodes a fresh copy, the copy is small next to the decoding
+	std::vector<u8> buffer(data.size());
+	std::size_t runs = std::max<std::size_t>(1, 50000000 / data.size());
+	double decodeTime = measure([&](){
+		for (std::size_t i = 0; i < runs; i++)
+		{
+			std::memcpy(buffer.data(), compressed.data(), compressed.size());
+			BLZ::uncompressInplace(buffer.data() + compressed.size());
+		}
+	}) / double(runs);
+
+	if (buffer != data)
+	{
+		std::printf("  in-place decode FAILED\n");
+		return;
+	}
+	std::printf("  decode %7.3f ms %8.1f MB/s\n", decodeTime * 1e3, size / decodeTime / 1e6);
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<Input> inputs;
+	if (argc > 1)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			Input input;
+			if (!readInput(argv[i], input))
+			{
+				std::fprintf(stderr, "Could not read %s\n", argv[i]);
+				return 1;
+			}
+			inputs.push_back(std::move(input));
+		}
+	}
+	else
+	{
+		inputs = makeInputs();
+	}
+
+	for (const Input& input : inputs)
+		benchInput(input);
+
+	return 0;
+}
@@ -1,114 +1,344 @@
 #include "blz.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
+#include <future>
 
 static const char* SRC_SHORTAGE = "Source shortage.";
 static const char* DEST_OVERRUN = "Destination overrun.";
 
-static int CompressBackward_sub2(const u8 *a1, const u8 *a2, int a3)
+constexpr u32 BLZ_THRESHOLD = 2;      // Matches must be longer than this to be encoded
+constexpr u32 BLZ_MAX_LENGTH = 18;    // Max length of a match (4 bits + 3)
+constexpr u32 BLZ_MIN_OFFSET = 3;     // Min distance of a match
+constexpr u32 BLZ_MAX_OFFSET = 4098;  // Max distance of a match (12 bits + 3)
+
+constexpr u32 HASH_BITS = 15;
+constexpr u32 HASH_SIZE = 1 << HASH_BITS;
+constexpr u32 CHAIN_SIZE = 8192;      // Must be a power of 2 greater than BLZ_MAX_OFFSET
+constexpr u32 CHAIN_MASK = CHAIN_SIZE - 1;
+constexpr s32 CHAIN_END = -1;
+
+constexpr size_t CHUNK_SIZE = 0x40000; // Size of the blocks parsed in parallel
+
+/*
+ * Finds backward matches using hash chains keyed on the 3 bytes
+ * that precede a position (src[pos], src[pos - 1], src[pos - 2]).
+ *
+ * Positions are inserted while the compressor walks towards the start
+ * of the buffer, so the head of a chain is always the closest candidate.
+ * Because only candidates sharing the 3 byte key are visited, the result
+ * is exactly the same as scanning the whole window for the longest match.
+ *
+ * Matches never extend below "begin", but may reference any data above
+ * "end", which allows blocks of the input to be parsed independently.
+ */
+class BackwardMatchFinder
 {
-	int i;
-	for (i = 0; i < a3 && *a1 == *a2; ++i)
+public:
+	explicit BackwardMatchFinder(const u8* src, size_t size, size_t begin, size_t end) :
+		m_src(src),
+		m_begin(begin),
+		m_nextInsert(std::min<size_t>(size, end + BLZ_MAX_OFFSET)),
+		m_head(HASH_SIZE, CHAIN_END),
+		m_chain(CHAIN_SIZE, CHAIN_END)
+	{}
+
+	/**
+	 * @brief Finds the longest match for the bytes ending at a position.
+	 *
+	 * @param pos The index of the byte being encoded, matches extend towards index 0.
+	 * @param offsetOut The distance of the match found.
+	 *
+	 * @return The length of the match found, 0 if none.
+	 */
+	u32 find(size_t pos, u32& offsetOut)
 	{
-		--a1;
-		--a2;
+		insertUntil(pos + BLZ_MIN_OFFSET);
+
+		if (pos < m_begin + BLZ_THRESHOLD)
+			return 0;
+
+		const u8* cur = &m_src[pos];
+		u32 maxLength = u32(std::min<size_t>(BLZ_MAX_LENGTH, pos + 1 - m_begin));
+		u32 bestLength = 0;
+
+		for (s32 candPos = m_head[hashAt(pos)]; candPos != CHAIN_END; candPos = m_chain[candPos & CHAIN_MASK])
+		{
+			size_t offset = size_t(candPos) - pos;
+			if (offset > BLZ_MAX_OFFSET)
+				break;
+
+			// Matches may not overlap the bytes they are copied from
+			u32 candMaxLength = std::min<u32>(maxLength, u32(offset));
+			if (candMaxLength <= bestLength)
+				continue;
+
+			const u8* cand = &m_src[candPos];
+			u32 length = 0;
+			while (length < candMaxLength && cur[-s32(length)] == cand[-s32(length)])
+				length++;
+
+			if (length > bestLength)
+			{
+				bestLength = length;
+				offsetOut = u32(offset);
+				if (length == maxLength)
+					break;
+			}
+		}
+
+		return bestLength;
+	}
+
+private:
+	const u8* m_src;
+	size_t m_begin;
+	size_t m_nextInsert;
+	std::vector<s32> m_head;
+	std::vector<s32> m_chain;
+
+	[[nodiscard]] u32 hashAt(size_t pos) const
+	{
+		u32 key = (u32(m_src[pos]) << 16) | (u32(m_src[pos - 1]) << 8) | u32(m_src[pos - 2]);
+		return (key * 2654435761u) >> (32 - HASH_BITS);
+	}
+
+	void insertUntil(size_t pos)
+	{
+		while (m_nextInsert > pos)
+		{
+			size_t insPos = --m_nextInsert;
+			u32 hash = hashAt(insPos);
+			m_chain[insPos & CHAIN_MASK] = m_head[hash];
+			m_head[hash] = s32(insPos);
+		}
+	}
+};
+
+struct BackwardToken
+{
+	u16 length; // 1 for a literal
+	u16 offset;
+};
+
+/**
+ * @brief Parses a block by taking the longest match at each position.
+ *
+ * @param src Pointer to input data begin.
+ * @param size Size of the input data.
+ * @param begin The index of the first byte of the block.
+ * @param end The index after the last byte of the block.
+ * @param tokensOut The tokens covering the block, in decoding order.
+ */
+static void ParseGreedy(const u8* src, size_t size, size_t begin, size_t end, std::vector<BackwardToken>& tokensOut)
+{
+	BackwardMatchFinder finder(src, size, begin, end);
+
+	size_t remaining = end;
+	while (remaining > begin)
+	{
+		u32 offset;
+		u32 length = finder.find(remaining - 1, offset);
+		if (length > BLZ_THRESHOLD)
+		{
+			tokensOut.push_back({ u16(length), u16(offset) });
+			remaining -= length;
+		}
+		else
+		{
+			tokensOut.push_back({ 1, 0 });
+			remaining--;
+		}
 	}
-	return i;
 }
 
-static int CompressBackward_sub1(const u8 *a1, int a2, const u8 *a3, int a4, int& a5)
+/**
+ * @brief Parses a block by finding the parse with the smallest encoded size.
+ *
+ * Encoding goes from the end of the data to its start, so the
+ * cost of encoding the first N bytes only depends on shorter prefixes.
+ * Any match can also be shortened without changing its offset,
+ * so only the longest match at each position needs to be known.
+ *
+ * @param src Pointer to input data begin.
+ * @param size Size of the input data.
+ * @param begin The index of the first byte of the block.
+ * @param end The index after the last byte of the block.
+ * @param tokensOut The tokens covering the block, in decoding order.
+ */
+static void ParseOptimal(const u8* src, size_t size, size_t begin, size_t end, std::vector<BackwardToken>& tokensOut)
 {
-	u8 v10 = a1[a2 - 1];
-	int v7 = 0;
-	for (int i = 0; i < a4; ++i)
+	constexpr u32 LiteralCost = 9;  // 8 bits + flag bit
+	constexpr u32 MatchCost = 17;   // 16 bits + flag bit
+
+	// Indexed by the amount of bytes of the block left to encode
+	size_t blockSize = end - begin;
+	std::vector<BackwardToken> longest(blockSize + 1, BackwardToken{ 1, 0 });
+
+	BackwardMatchFinder finder(src, size, begin, end);
+	for (size_t remaining = blockSize; remaining > 0; remaining--)
+	{
+		u32 offset;
+		u32 length = finder.find(begin + remaining - 1, offset);
+		if (length > BLZ_THRESHOLD)
+			longest[remaining] = { u16(length), u16(offset) };
+	}
+
+	std::vector<u64> costs(blockSize + 1);
+	std::vector<u8> lengths(blockSize + 1);
+	costs[0] = 0;
+	for (size_t remaining = 1; remaining <= blockSize; remaining++)
 	{
-		if (a3[i] == v10)
+		u64 bestCost = costs[remaining - 1] + LiteralCost;
+		u32 bestLength = 1;
+
+		u32 maxLength = longest[remaining].length;
+		for (u32 length = BLZ_THRESHOLD + 1; length <= maxLength; length++)
 		{
-			int v6 = i + 1;
-			if (i + 1 > a2)
-				v6 = a2;
-			int v8 = CompressBackward_sub2(&a1[a2 - 1], &a3[i], v6);
-			if (v7 < v8)
+			u64 cost = costs[remaining - length] + MatchCost;
+			if (cost < bestCost)
 			{
-				v7 = v8;
-				a5 = i;
+				bestCost = cost;
+				bestLength = length;
 			}
 		}
+
+		costs[remaining] = bestCost;
+		lengths[remaining] = u8(bestLength);
+	}
+
+	size_t remaining = blockSize;
+	while (remaining > 0)
+	{
+		u32 length = lengths[remaining];
+		tokensOut.push_back({ u16(length), length == 1 ? u16(0) : longest[remaining].offset });
+		remaining -= length;
 	}
-	return v7;
+}
+
+static void ParseBackward(const u8* src, size_t size, size_t begin, size_t end, BLZ::CompressMode mode, std::vector<BackwardToken>& tokensOut)
+{
+	tokensOut.clear();
+	if (mode == BLZ::CompressMode::Best)
+		ParseOptimal(src, size, begin, end, tokensOut);
+	else
+		ParseGreedy(src, size, begin, end, tokensOut);
 }
 
 /**
  * @brief Compress module data.
- * 
+ *
+ * Tokens are emitted in the order the decoder consumes them,
+ * meaning that the stream must be reversed before being stored.
+ *
  * @param src Pointer to input data begin.
  * @param size Size of the input data.
- * @param dst Pointer to output data begin.
- * 
- * @return The number of compressed bytes. (in_size - out_size)
+ * @param blocks The parsed blocks, ordered from the end of the data to its start.
+ * @param pak The encoded token stream.
+ * @param pakSizeOut The amount of encoded bytes that must be kept.
+ * @param rawSizeOut The amount of bytes at the start of the input that must be kept uncompressed.
  */
-static size_t CompressBackward(const void *src, size_t size, void *dst)
+static void CompressBackward(const u8* src, size_t size, const std::vector<std::vector<BackwardToken>>& blocks, std::vector<u8>& pak, size_t& pakSizeOut, size_t& rawSizeOut)
 {
-	const u8* src_ = reinterpret_cast<const u8*>(src);
-	u8* dst_ = reinterpret_cast<u8*>(dst);
+	pak.clear();
+	pak.reserve(size + (size / 8) + 1);
+
+	// Find the split that keeps the decoder from overwriting data it did not read yet
+	pakSizeOut = 0;
+	rawSizeOut = size;
 
-	size_t v13 = size;
-	size_t v12 = size;
-	while (v13 > 0)
+	size_t remaining = size;
+	size_t flagPos = 0;
+	u8 flagMask = 0;
+
+	for (const std::vector<BackwardToken>& tokens : blocks)
 	{
-		if (v12 <= 0)
-			return -1;
-		int v11 = 0;
-		int v10 = --v12;
-		for (int i = 0; i <= 7; ++i)
+		for (const BackwardToken& token : tokens)
 		{
-			v11 *= 2;
-			if (v13 > 0)
+			if (flagMask == 0)
 			{
-				const u8* v9 = &src_[v13];
-				int v8 = size - v13;
-				int v2 = v13;
-				if (v13 > 18)
-					v2 = 18;
-				int v6 = v2;
-				const u8* v7 = &v9[-v2];
-				int v1 = v8;
-				if (v8 > 4098)
-					v1 = 4098;
-				int v5;
-				int v4 = CompressBackward_sub1(v7, v6, v9, v1, v5);
-				if (v4 <= 2)
-				{
-					if (v12 <= 0)
-						return -1;
-					dst_[--v12] = src_[--v13];
-				}
-				else
-				{
-					if (v12 <= 1)
-					  return -1;
-					v13 -= v4;
-					v5 -= 2;
-					u16 v3 = v5 & 0xFFF | (((u16)v4 - 3) << 12);
-					--v12;
-					dst_[v12--] = v3 >> 8;
-					dst_[v12] = v3;
-					v11 |= 1;
-				}
+				flagPos = pak.size();
+				pak.push_back(0);
+				flagMask = 0x80;
+			}
+
+			if (token.length > BLZ_THRESHOLD)
+			{
+				u16 value = u16((token.offset - BLZ_MIN_OFFSET) & 0xFFF) | u16((token.length - (BLZ_THRESHOLD + 1)) << 12);
+				pak.push_back(u8(value >> 8));
+				pak.push_back(u8(value));
+				pak[flagPos] |= flagMask;
+				remaining -= token.length;
+			}
+			else
+			{
+				pak.push_back(src[--remaining]);
+			}
+
+			flagMask >>= 1;
+
+			if (pak.size() + remaining < pakSizeOut + rawSizeOut)
+			{
+				pakSizeOut = pak.size();
+				rawSizeOut = remaining;
 			}
 		}
-		dst_[v10] = v11;
 	}
-	return v12;
+}
+
+/**
+ * @brief Builds the final module data from an encoded token stream.
+ *
+ * @return The compressed data, empty if the data could not be made smaller.
+ */
+static std::vector<u8> MakeCompressedData(const std::vector<u8>& data, const std::vector<std::vector<BackwardToken>>& blocks)
+{
+	size_t dataSize = data.size();
+
+	std::vector<u8> pak;
+	size_t pakSize, rawSize;
+	CompressBackward(data.data(), dataSize, blocks, pak, pakSize, rawSize);
+
+	if (pakSize == 0)
+		return {};
+
+	size_t hdrSize = 8;
+	while ((rawSize + pakSize + hdrSize) & 3)
+		hdrSize++;
+
+	size_t destSize = rawSize + pakSize + hdrSize;
+	if (destSize >= dataSize)
+		return {};
+
+	std::vector<u8> dest(destSize, 0xFF);
+	std::copy(data.begin(), data.begin() + rawSize, dest.begin());
+	std::reverse_copy(pak.begin(), pak.begin() + pakSize, dest.begin() + rawSize);
+
+	u32 offsetIn = u32(pakSize + hdrSize) | (u32(hdrSize) << 24);
+	u32 offsetOut = u32(dataSize - destSize);
+	std::memcpy(&dest[destSize - 8], &offsetIn, 4);
+	std::memcpy(&dest[destSize - 4], &offsetOut, 4);
+
+	return dest;
 }
 
 /**
  * @brief Uncompress module data.
- * 
+ *
+ * Flag groups far enough from the buffer edges are decoded without any
+ * bounds checks: a group reads at most 16 bytes and moves the output at
+ * most 128 bytes closer to the input, so a single check covers all 8 tokens.
+ * Non-overlapping matches are then copied with fixed size moves.
+ * Groups near the edges use the checked path, which reports any error.
+ *
  * @param bottom Pointer to input data end.
  */
 static void UncompressBackward(void* bottom)
 {
+	constexpr ptrdiff_t GroupMaxIn = 8 * 2;
+	constexpr ptrdiff_t GroupMaxGap = 8 * (BLZ_MAX_LENGTH - 2) + 16;
+
 	u32 offsetOut   = *(reinterpret_cast<u32*>(bottom) - 1);
 	u32 offsetIn    = *(reinterpret_cast<u32*>(bottom) - 2);
 	u32 offsetInBtm = offsetIn >> 24;
@@ -122,6 +352,55 @@ static void UncompressBackward(void* bottom)
 	{
 		u8 flag = *--pInBtm;
 
+		if (pInBtm - pInTop >= GroupMaxIn && pOut - pInBtm >= GroupMaxGap)
+		{
+			// 8 literals, the output is never below the input so memmove matches the byte loop
+			if (flag == 0)
+			{
+				pOut -= 8;
+				pInBtm -= 8;
+				std::memmove(pOut, pInBtm, 8);
+				continue;
+			}
+
+			for (int i = 0; i < 8; ++i)
+			{
+				if (!(flag & 0x80))
+				{
+					*--pOut = *--pInBtm;
+				}
+				else
+				{
+					u32 length = *--pInBtm;
+					u32 offset = (((length & 0xF) << 8) | (*--pInBtm)) + 3;
+					length = (length >> 4) + 3;
+
+					const u8* pTmp = pOut + offset;
+
+					if (offset >= 16 && length <= 16)
+					{
+						// The extra bytes written below the match are overwritten by the next tokens
+						std::memcpy(pOut - 16, pTmp - 16, 16);
+						pOut -= length;
+					}
+					else if (offset >= length)
+					{
+						pOut -= length;
+						std::memcpy(pOut, pTmp - length, length);
+					}
+					else
+					{
+						for (u32 j = 0; j < length; ++j)
+							*--pOut = *--pTmp;
+					}
+				}
+
+				flag <<= 1;
+			}
+
+			continue;
+		}
+
 		for (int i = 0; i < 8; ++i)
 		{
 			if (pInBtm < pInTop)
@@ -162,17 +441,35 @@ static void UncompressBackward(void* bottom)
 
 namespace BLZ
 {
-	std::vector<u8> compress(const std::vector<u8>& data)
+	std::vector<u8> compress(const std::vector<u8>& data, CompressMode mode)
+	{
+		std::vector<std::vector<BackwardToken>> blocks(1);
+		ParseBackward(data.data(), data.size(), 0, data.size(), mode, blocks[0]);
+		return MakeCompressedData(data, blocks);
+	}
+
+	std::vector<u8> compress(const std::vector<u8>& data, CompressMode mode, BS::thread_pool& pool)
 	{
 		size_t dataSize = data.size();
-		std::vector<u8> dest(dataSize);
+		size_t blockCount = std::max<size_t>(1, (dataSize + CHUNK_SIZE - 1) / CHUNK_SIZE);
 
-		size_t destSize = CompressBackward(data.data(), dataSize, dest.data());
-		if (destSize == -1)
-			throw std::runtime_error("Compression failed.");
+		// Blocks are parsed from the end of the data, like the decoder reads them
+		std::vector<std::vector<BackwardToken>> blocks(blockCount);
+		std::vector<std::future<void>> results;
+		results.reserve(blockCount);
+		for (size_t i = 0; i < blockCount; i++)
+		{
+			size_t end = dataSize - std::min(dataSize, i * CHUNK_SIZE);
+			size_t begin = end - std::min(end, CHUNK_SIZE);
+			std::vector<BackwardToken>& tokens = blocks[i];
+			results.emplace_back(pool.submit([&data, begin, end, mode, &tokens](){
+				ParseBackward(data.data(), data.size(), begin, end, mode, tokens);
+			}));
+		}
+		for (std::future<void>& result : results)
+			result.get();
 
-		dest.resize(destSize);
-		return dest;
+		return MakeCompressedData(data, blocks);
 	}
 
 	std::vector<u8> uncompress(const std::vector<u8>& data)
@@ -182,7 +479,7 @@ namespace BLZ
 
 		std::vector<u8> dest(destSize);
 		std::copy(data.begin(), data.end(), dest.begin());
-		
+
 		UncompressBackward(dest.data() + dataSize);
 
 		return dest;
@@ -193,7 +490,7 @@ namespace BLZ
 		size_t dataSize = data.size();
 		u32 destSize = dataSize + *reinterpret_cast<u32*>(&data[dataSize - 4]);
 		data.resize(destSize);
-		
+
 		UncompressBackward(data.data() + dataSize);
 	}
 
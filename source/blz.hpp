@@ -4,16 +4,39 @@
 
 #include "types.hpp"
 
+#include <BS_thread_pool.hpp>
+
 namespace BLZ
 {
+	enum class CompressMode
+	{
+		Fast = 0, // Greedy, takes the longest match at each position
+		Best      // Optimal parse, slower but gives the smallest output
+	};
+
 	/**
 	 * @brief Compress module data.
 	 * 
 	 * @param data The data to compress.
+	 * @param mode The strategy used to choose matches.
+	 * 
+	 * @return The compressed data, empty if the data could not be made smaller.
+	 */
+	std::vector<u8> compress(const std::vector<u8>& data, CompressMode mode = CompressMode::Fast);
+
+	/**
+	 * @brief Compress module data, splitting the work into blocks.
+	 * 
+	 * Each block is parsed on the thread pool, the blocks may still
+	 * reference data from each other so the ratio stays nearly the same.
+	 * 
+	 * @param data The data to compress.
+	 * @param mode The strategy used to choose matches.
+	 * @param pool The thread pool to parse the blocks on.
 	 * 
-	 * @return The compressed data.
+	 * @return The compressed data, empty if the data could not be made smaller.
 	 */
-	std::vector<u8> compress(const std::vector<u8>& data);
+	std::vector<u8> compress(const std::vector<u8>& data, CompressMode mode, BS::thread_pool& pool);
 
 	/**
 	 * @brief Uncompress module data.
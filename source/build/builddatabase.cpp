@@ -0,0 +1,349 @@
+#include "builddatabase.hpp"
+
+#include <chrono>
+#include <fstream>
+#include <vector>
+
+#include "../util.hpp"
+
+namespace fs = std::filesystem;
+
+constexpr u32 BuildDatabaseVersion = 6;
+
+// The coarsest write time granularity among the supported file systems, FAT has 2 seconds
+constexpr s64 WriteTimeGranularity =
+	std::chrono::duration_cast<std::filesystem::file_time_type::duration>(std::chrono::seconds(2)).count();
+
+BuildDatabase::BuildDatabase() = default;
+
+void BuildDatabase::load(const fs::path& path)
+{
+	m_path = path;
+	m_files.clear();
+	m_objects.clear();
+	m_dirs.clear();
+	m_paths.clear();
+	m_pathIDs.clear();
+
+	if (!fs::exists(path))
+		return;
+
+	std::ifstream inputFile(path, std::ios::binary);
+	if (!inputFile.is_open())
+		return;
+	std::vector<u8> data(fs::file_size(path));
+	inputFile.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size()));
+	inputFile.close();
+
+	const u8* curDataPtr = data.data();
+	const u8* endDataPtr = curDataPtr + data.size();
+	bool valid = true;
+
+	auto read = [&]<typename T>(){
+		if (std::size_t(endDataPtr - curDataPtr) < sizeof(T))
+		{
+			valid = false;
+			return T();
+		}
+		T value = Util::read<T>(curDataPtr);
+		curDataPtr += sizeof(T);
+		return value;
+	};
+
+	auto readString = [&](){
+		u32 length = read.template operator()<u32>();
+		if (!valid || std::size_t(endDataPtr - curDataPtr) < length)
+		{
+			valid = false;
+			return std::string();
+		}
+		std::string str(reinterpret_cast<const char*>(curDataPtr), length);
+		curDataPtr += length;
+		return str;
+	};
+
+	if (read.template operator()<u32>() != BuildDatabaseVersion)
+		return;
+
+	u32 fileCount = read.template operator()<u32>();
+	for (u32 i = 0; i < fileCount && valid; i++)
+	{
+		std::string filePath = readString();
+		FileEntry entry;
+		entry.writeTime = read.template operator()<s64>();
+		entry.size = read.template operator()<u64>();
+		entry.hashTime = read.template operator()<s64>();
+		entry.hash = read.template operator()<u64>();
+		entry.used = false;
+		m_files.emplace(std::move(filePath), entry);
+	}
+
+	auto readStrings = [&](std::vector<std::string>& out){
+		u32 count = read.template operator()<u32>();
+		for (u32 i = 0; i < count && valid; i++)
+			out.push_back(readString());
+	};
+
+	u32 dirCount = read.template operator()<u32>();
+	for (u32 i = 0; i < dirCount && valid; i++)
+	{
+		std::string dirPath = readString();
+		StoredDirectory dir;
+		dir.writeTime = read.template operator()<s64>();
+		dir.listTime = read.template operator()<s64>();
+		readStrings(dir.entry.files);
+		readStrings(dir.entry.subdirs);
+		dir.used = false;
+		m_dirs.emplace(std::move(dirPath), std::move(dir));
+	}
+
+	u32 pathCount = read.template operator()<u32>();
+	for (u32 i = 0; i < pathCount && valid; i++)
+	{
+		std::string depPath = readString();
+		m_pathIDs.emplace(depPath, u32(m_paths.size()));
+		m_paths.emplace_back(std::move(depPath));
+	}
+
+	u32 objectCount = read.template operator()<u32>();
+	for (u32 i = 0; i < objectCount && valid; i++)
+	{
+		std::string objPath = readString();
+		ObjectEntry entry;
+		entry.commandHash = read.template operator()<u64>();
+		entry.inputHash = read.template operator()<u64>();
+		u32 depCount = read.template operator()<u32>();
+		if (!valid || std::size_t(endDataPtr - curDataPtr) < std::size_t(depCount) * sizeof(u32))
+		{
+			valid = false;
+			break;
+		}
+		entry.deps.resize(depCount);
+		for (u32& depID : entry.deps)
+		{
+			depID = read.template operator()<u32>();
+			if (depID >= m_paths.size())
+				valid = false;
+		}
+		m_objects.emplace(std::move(objPath), std::move(entry));
+	}
+
+	// A damaged database is dropped as a whole
+	if (!valid)
+	{
+		m_files.clear();
+		m_objects.clear();
+		m_dirs.clear();
+		m_paths.clear();
+		m_pathIDs.clear();
+	}
+}
+
+void BuildDatabase::save()
+{
+	std::vector<u8> data;
+
+	auto write = [&data]<typename T>(T value){
+		std::size_t pos = data.size();
+		data.resize(pos + sizeof(T));
+		Util::write<T>(&data[pos], value);
+	};
+
+	auto writeString = [&](const std::string& str){
+		write.template operator()<u32>(u32(str.length()));
+		data.insert(data.end(), str.begin(), str.end());
+	};
+
+	write.template operator()<u32>(BuildDatabaseVersion);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Files that were not needed by this build are forgotten
+	u32 fileCount = 0;
+	for (const auto& [filePath, entry] : m_files)
+		fileCount += entry.used;
+
+	write.template operator()<u32>(fileCount);
+	for (const auto& [filePath, entry] : m_files)
+	{
+		if (!entry.used)
+			continue;
+		writeString(filePath);
+		write.template operator()<s64>(entry.writeTime);
+		write.template operator()<u64>(entry.size);
+		write.template operator()<s64>(entry.hashTime);
+		write.template operator()<u64>(entry.hash);
+	}
+
+	auto writeStrings = [&](const std::vector<std::string>& strs){
+		write.template operator()<u32>(u32(strs.size()));
+		for (const std::string& str : strs)
+			writeString(str);
+	};
+
+	// Directories that were not searched by this build are forgotten
+	u32 dirCount = 0;
+	for (const auto& [dirPath, dir] : m_dirs)
+		dirCount += dir.used;
+
+	write.template operator()<u32>(dirCount);
+	for (const auto& [dirPath, dir] : m_dirs)
+	{
+		if (!dir.used)
+			continue;
+		writeString(dirPath);
+		write.template operator()<s64>(dir.writeTime);
+		write.template operator()<s64>(dir.listTime);
+		writeStrings(dir.entry.files);
+		writeStrings(dir.entry.subdirs);
+	}
+
+	// Only the paths still listed by an object are kept, their IDs are renumbered
+	std::vector<u32> savedIDs(m_paths.size(), u32(-1));
+	std::vector<u32> savedPaths;
+	for (const auto& [objPath, entry] : m_objects)
+	{
+		for (u32 depID : entry.deps)
+		{
+			if (savedIDs[depID] != u32(-1))
+				continue;
+			savedIDs[depID] = u32(savedPaths.size());
+			savedPaths.push_back(depID);
+		}
+	}
+
+	write.template operator()<u32>(u32(savedPaths.size()));
+	for (u32 depID : savedPaths)
+		writeString(m_paths[depID]);
+
+	write.template operator()<u32>(u32(m_objects.size()));
+	for (const auto& [objPath, entry] : m_objects)
+	{
+		writeString(objPath);
+		write.template operator()<u64>(entry.commandHash);
+		write.template operator()<u64>(entry.inputHash);
+		write.template operator()<u32>(u32(entry.deps.size()));
+		for (u32 depID : entry.deps)
+			write.template operator()<u32>(savedIDs[depID]);
+	}
+
+	// Replaced as a whole, a database lost to a crash only costs a full rebuild
+	Util::writeFileIfChanged(m_path, data.data(), data.size(), false);
+}
+
+bool BuildDatabase::getFileHash(const fs::path& path, u64& hashOut)
+{
+	// The time is taken before reading, so a change made while reading also makes the hash untrusted
+	s64 hashTime = s64(fs::file_time_type::clock::now().time_since_epoch().count());
+
+	std::error_code ec;
+	fs::file_time_type writeTime = fs::last_write_time(path, ec);
+	if (ec)
+		return false;
+	std::uintmax_t size = fs::file_size(path, ec);
+	if (ec)
+		return false;
+
+	FileEntry entry;
+	entry.writeTime = s64(writeTime.time_since_epoch().count());
+	entry.size = u64(size);
+	entry.hashTime = hashTime;
+	entry.used = true;
+
+	std::string pathStr = path.string();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_files.find(pathStr);
+		if (it != m_files.end() && it->second.writeTime == entry.writeTime && it->second.size == entry.size &&
+			it->second.hashTime - it->second.writeTime > WriteTimeGranularity)
+		{
+			it->second.used = true;
+			hashOut = it->second.hash;
+			return true;
+		}
+	}
+
+	// A changed write time alone, like after a checkout, only costs hashing the file again
+	std::ifstream inputFile(path, std::ios::binary);
+	if (!inputFile.is_open())
+		return false;
+	std::vector<u8> data(size);
+	inputFile.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size()));
+	if (inputFile.gcount() != std::streamsize(data.size()))
+		return false;
+	inputFile.close();
+
+	entry.hash = Util::hash64(data.data(), data.size());
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_files[pathStr] = entry;
+	}
+
+	hashOut = entry.hash;
+	return true;
+}
+
+const BuildDatabase::DirectoryEntry& BuildDatabase::getDirectory(const fs::path& path)
+{
+	// The time is taken before listing, so a change made while listing also makes the listing untrusted
+	s64 listTime = s64(fs::file_time_type::clock::now().time_since_epoch().count());
+	s64 writeTime = s64(fs::last_write_time(path).time_since_epoch().count());
+
+	std::string pathStr = path.string();
+	auto it = m_dirs.find(pathStr);
+	if (it != m_dirs.end() && it->second.writeTime == writeTime &&
+		it->second.listTime - it->second.writeTime > WriteTimeGranularity)
+	{
+		it->second.used = true;
+		return it->second.entry;
+	}
+
+	StoredDirectory dir;
+	dir.writeTime = writeTime;
+	dir.listTime = listTime;
+	dir.used = true;
+	for (const fs::directory_entry& entry : fs::directory_iterator(path))
+	{
+		if (entry.is_directory())
+			dir.entry.subdirs.push_back(entry.path().filename().string());
+		else if (entry.is_regular_file())
+			dir.entry.files.push_back(entry.path().filename().string());
+	}
+
+	StoredDirectory& storedDir = m_dirs[pathStr];
+	storedDir = std::move(dir);
+	return storedDir.entry;
+}
+
+const BuildDatabase::ObjectEntry* BuildDatabase::findObject(const std::string& objPath) const
+{
+	auto it = m_objects.find(objPath);
+	if (it == m_objects.end())
+		return nullptr;
+	return &it->second;
+}
+
+void BuildDatabase::setObject(const std::string& objPath, ObjectEntry entry)
+{
+	m_objects[objPath] = std::move(entry);
+}
+
+void BuildDatabase::clearObjects()
+{
+	// The paths are kept, the entries set afterwards may still refer to them
+	m_objects.clear();
+}
+
+u32 BuildDatabase::getPathID(const std::string& path)
+{
+	auto it = m_pathIDs.find(path);
+	if (it != m_pathIDs.end())
+		return it->second;
+
+	u32 id = u32(m_paths.size());
+	m_paths.push_back(path);
+	m_pathIDs.emplace(path, id);
+	return id;
+}
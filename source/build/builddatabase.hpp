@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+#include "../types.hpp"
+
+/*
+ * Remembers what the objects of a target were built from,
+ * it is stored in the build directory of the target.
+ * */
+class BuildDatabase
+{
+public:
+	BuildDatabase();
+
+	// A missing or unreadable database is loaded as empty, which rebuilds everything.
+	void load(const std::filesystem::path& path);
+	void save();
+
+	// Gets the hash of the file contents, the file is only read again when its size or write time changed.
+	// A hash made right after the file was written is not trusted, like a directory listing.
+	// Returns false if the file can not be read. Safe to call from several threads.
+	bool getFileHash(const std::filesystem::path& path, u64& hashOut);
+
+	struct ObjectEntry
+	{
+		u64 commandHash;      // Hash of the command line the object was built with
+		u64 inputHash;        // Hash of the command line and the dependencies, only set by the hash rebuild check
+		std::vector<u32> deps; // IDs of the paths the compiler listed as dependencies
+	};
+
+	// Returns nullptr if the object is not known.
+	[[nodiscard]] const ObjectEntry* findObject(const std::string& objPath) const;
+	void setObject(const std::string& objPath, ObjectEntry entry);
+	void clearObjects();
+
+	// Dependency paths are stored once and referred to by their ID,
+	// so a header shared by many objects is only checked once.
+	u32 getPathID(const std::string& path);
+	[[nodiscard]] const std::string& getPath(u32 id) const { return m_paths[id]; }
+	[[nodiscard]] std::size_t getPathCount() const { return m_paths.size(); }
+
+	struct DirectoryEntry
+	{
+		std::vector<std::string> files;   // Names of the regular files
+		std::vector<std::string> subdirs; // Names of the subdirectories
+	};
+
+	// Lists the directory, it is only read again when its write time changed,
+	// which happens whenever an entry is added, removed or renamed.
+	// A listing made right after the directory changed is not trusted, as another
+	// change within the timestamp granularity would not change its write time.
+	// Throws if the directory can not be read. Not safe to call from several threads.
+	const DirectoryEntry& getDirectory(const std::filesystem::path& path);
+
+private:
+	struct StoredDirectory
+	{
+		s64 writeTime;
+		s64 listTime; // When the directory was listed, on the clock of the write times
+		DirectoryEntry entry;
+		bool used;
+	};
+
+	struct FileEntry
+	{
+		s64 writeTime;
+		u64 size;
+		s64 hashTime; // When the file was hashed, on the clock of the write times
+		u64 hash;
+		bool used;
+	};
+
+	std::filesystem::path m_path;
+	std::mutex m_mutex;
+	std::unordered_map<std::string, FileEntry> m_files;
+	std::unordered_map<std::string, ObjectEntry> m_objects;
+	std::unordered_map<std::string, StoredDirectory> m_dirs;
+	std::vector<std::string> m_paths;
+	std::unordered_map<std::string, u32> m_pathIDs;
+};
@@ -2,16 +2,30 @@
 
 #include <iostream>
 
+#include "../main.hpp"
+#include "../util.hpp"
 #include "../log.hpp"
 
 static char s_progAnimFrames[] = { '-', '\\', '|', '/', '-', '\\', '|', '/' };
 
 BuildLogger::BuildLogger() = default;
 
-void BuildLogger::start(const std::filesystem::path& targetRoot)
+void BuildLogger::addJobs(const std::vector<std::unique_ptr<SourceFileJob>>& jobs, const std::filesystem::path& targetRoot)
+{
+	for (const std::unique_ptr<SourceFileJob>& job : jobs)
+	{
+		std::string filePath = Util::relativeIfSubpath(targetRoot / job->srcFilePath, Main::getWorkPath()).string();
+		m_jobs.push_back(LoggedJob{ job.get(), std::move(filePath) });
+	}
+}
+
+void BuildLogger::start()
 {
 	Log::out << OBUILD << "Starting..." << std::endl;
 
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_active = true;
+
 	Log::setMode(LogMode::Console);
 #ifndef _WIN32
 	Log::showCursor(false);
@@ -21,9 +35,9 @@ void BuildLogger::start(const std::filesystem::path& targetRoot)
 	m_failureFound = false;
 	m_filesToBuild = 0;
 
-	for (const std::unique_ptr<SourceFileJob>& job : *m_jobs)
+	for (const LoggedJob& loggedJob : m_jobs)
 	{
-		if (job->rebuild)
+		if (loggedJob.job->rebuild)
 			m_filesToBuild++;
 	}
 
@@ -32,20 +46,30 @@ void BuildLogger::start(const std::filesystem::path& targetRoot)
 
 	m_cursorOffsetY = Log::getXY().y - bufLineShift;
 
-	for (const std::unique_ptr<SourceFileJob>& job : *m_jobs)
+	for (const LoggedJob& loggedJob : m_jobs)
 	{
-		if (!job->rebuild)
+		if (!loggedJob.job->rebuild)
 			continue;
-		std::string filePath = job->srcFilePath.string();
-		Log::out << OBUILD << OSQRTBRKTS(ANSI_bWHITE, , "-") << ' ' << ANSI_bYELLOW << filePath << ANSI_RESET;
+		Log::out << OBUILD << OSQRTBRKTS(ANSI_bWHITE, , "-") << ' ' << ANSI_bYELLOW << loggedJob.filePath << ANSI_RESET;
 		Log::out << std::endl;
 	}
+
+	// Other tasks of the build may log while compiling, that would move the lines written to
+	Log::setDeferred(true);
 }
 
 void BuildLogger::update()
 {
-	for (const std::unique_ptr<SourceFileJob>& job : *m_jobs)
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_active)
+		updateJobs();
+}
+
+void BuildLogger::updateJobs()
+{
+	for (const LoggedJob& loggedJob : m_jobs)
 	{
+		SourceFileJob* job = loggedJob.job;
 		if (!job->buildStarted || (job->finished && job->logWasFinished))
 			continue;
 		const int writeX = 9;
@@ -75,29 +99,33 @@ void BuildLogger::update()
 
 void BuildLogger::finish()
 {
-	update();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	updateJobs();
 	Log::gotoXY(0, m_cursorOffsetY + int(m_filesToBuild));
 
+	std::string deferredOutput = Log::takeDeferred();
+	Log::setDeferred(false);
+
 	Log::setMode(LogMode::File);
 
-	for (const std::unique_ptr<SourceFileJob>& job : *m_jobs)
+	for (const LoggedJob& loggedJob : m_jobs)
 	{
-		if (!job->rebuild)
+		if (!loggedJob.job->rebuild)
 			continue;
-		std::string filePath = job->srcFilePath.string();
-		Log::out << "[Build] [" << (job->failed ? 'E' : 'S') << "] " << filePath;
+		char state = loggedJob.job->failed ? 'E' : (loggedJob.job->finished ? 'S' : '-');
+		Log::out << "[Build] [" << state << "] " << loggedJob.filePath;
 		Log::out << std::endl;
 	}
 
 	Log::setMode(LogMode::Both);
 
 	auto printJobsOutput = [&](){
-		for (const std::unique_ptr<SourceFileJob>& job : *m_jobs)
+		for (const LoggedJob& loggedJob : m_jobs)
 		{
-			if (!job->output.empty())
+			if (!loggedJob.job->output.empty())
 			{
-				Log::out << "\n-------- " << ANSI_bYELLOW << job->srcFilePath.string() << ANSI_RESET << " --------\n";
-				Log::out << job->output << std::flush;
+				Log::out << "\n-------- " << ANSI_bYELLOW << loggedJob.filePath << ANSI_RESET << " --------\n";
+				Log::out << loggedJob.job->output << std::flush;
 			}
 		}
 		Log::out << std::endl;
@@ -111,9 +139,9 @@ void BuildLogger::finish()
 	else
 	{
 		bool foundWarnings = false;
-		for (const std::unique_ptr<SourceFileJob>& job : *m_jobs)
+		for (const LoggedJob& loggedJob : m_jobs)
 		{
-			if (!job->output.empty())
+			if (!loggedJob.job->output.empty())
 			{
 				foundWarnings = true;
 				break;
@@ -126,7 +154,21 @@ void BuildLogger::finish()
 		}
 	}
 
+	Log::out << deferredOutput << std::flush;
+
 #ifndef _WIN32
 	Log::showCursor(true);
 #endif
+
+	m_active = false;
+}
+
+bool BuildLogger::getAllFinished() const
+{
+	for (const LoggedJob& loggedJob : m_jobs)
+	{
+		if (loggedJob.job->rebuild && !loggedJob.job->finished)
+			return false;
+	}
+	return true;
 }
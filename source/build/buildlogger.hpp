@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstddef>
+#include <string>
 #include <vector>
 #include <memory>
 #include <mutex>
@@ -13,17 +14,31 @@ class BuildLogger
 public:
 	BuildLogger();
 
-	constexpr void setJobs(const std::vector<std::unique_ptr<SourceFileJob>>& jobs) { m_jobs = &jobs; }
+	// Jobs of several targets can be added, their paths are shown relative to the work directory
+	void addJobs(const std::vector<std::unique_ptr<SourceFileJob>>& jobs, const std::filesystem::path& targetRoot);
 
-	void start(const std::filesystem::path& targetRoot);
+	void start();
+	// May be called from another thread than the other methods, does nothing unless started.
 	void update();
 	void finish();
 	[[nodiscard]] constexpr bool getFailed() const { return m_failureFound; }
+	[[nodiscard]] constexpr bool getActive() const { return m_active; }
+	[[nodiscard]] bool getAllFinished() const;
 
 private:
+	struct LoggedJob
+	{
+		SourceFileJob* job;
+		std::string filePath;
+	};
+
+	std::mutex m_mutex;
+	bool m_active = false;
 	int m_cursorOffsetY;
 	int m_currentFrame;
 	bool m_failureFound;
 	std::size_t m_filesToBuild;
-	const std::vector<std::unique_ptr<SourceFileJob>>* m_jobs;
+	std::vector<LoggedJob> m_jobs;
+
+	void updateJobs();
 };
@@ -0,0 +1,161 @@
+#include "buildscheduler.hpp"
+
+#include <chrono>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+BuildScheduler::BuildScheduler(int threadCount) :
+	m_pool(threadCount)
+{}
+
+BuildScheduler::TaskID BuildScheduler::addTask(std::function<void()> task, const std::vector<TaskID>& deps, bool onWorker)
+{
+	TaskID id = m_tasks.size();
+	for (TaskID dep : deps)
+		m_tasks[dep].dependents.push_back(id);
+	m_tasks.push_back(Task{ std::move(task), {}, deps.size(), onWorker });
+	return id;
+}
+
+void BuildScheduler::notify()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_changed = true;
+	}
+	m_cond.notify_one();
+}
+
+void BuildScheduler::finishTask(TaskID id, std::exception_ptr error)
+{
+	// Must be called with the mutex locked
+	Task& task = m_tasks[id];
+	if (task.onWorker)
+		m_running--;
+	else
+		m_callerRunning = false;
+	m_finished++;
+	m_changed = true;
+
+	if (error && !m_error)
+		m_error = error;
+
+	for (TaskID dependentID : task.dependents)
+	{
+		Task& dependent = m_tasks[dependentID];
+		if (--dependent.depsLeft == 0)
+			(dependent.onWorker ? m_readyWorkerTasks : m_readyCallerTasks).push_back(dependentID);
+	}
+}
+
+void BuildScheduler::run(const std::function<void()>& onWake)
+{
+	std::size_t maxRunning = m_pool.get_thread_count();
+
+	std::thread callerThread;
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_changed = false;
+	m_running = 0;
+	m_callerRunning = false;
+	m_finished = 0;
+	m_readyWorkerTasks.clear();
+	m_readyCallerTasks.clear();
+	m_error = nullptr;
+
+	for (TaskID id = 0; id < m_tasks.size(); id++)
+	{
+		if (m_tasks[id].depsLeft == 0)
+			(m_tasks[id].onWorker ? m_readyWorkerTasks : m_readyCallerTasks).push_back(id);
+	}
+
+	while (true)
+	{
+		// Only as many tasks as there are workers are handed to the pool, so the
+		// work a caller task gives to the pool is not queued behind the whole build
+		while (!m_error && m_running < maxRunning && !m_readyWorkerTasks.empty())
+		{
+			TaskID id = m_readyWorkerTasks.front();
+			m_readyWorkerTasks.pop_front();
+			m_running++;
+
+			m_pool.push_task([this, id](){
+				std::exception_ptr error;
+				try
+				{
+					m_tasks[id].func();
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					finishTask(id, error);
+				}
+				m_cond.notify_one();
+			});
+		}
+
+		if (m_error ? (m_running == 0 && !m_callerRunning) : m_finished == m_tasks.size())
+			break;
+
+		// Caller tasks get a thread of their own, so the workers keep being
+		// handed tasks and onWake keeps being called while one of them runs
+		if (!m_error && !m_callerRunning && !m_readyCallerTasks.empty())
+		{
+			TaskID id = m_readyCallerTasks.front();
+			m_readyCallerTasks.pop_front();
+			m_callerRunning = true;
+
+			// The previous caller task has already finished, it only has to be joined
+			if (callerThread.joinable())
+				callerThread.join();
+
+			callerThread = std::thread([this, id](){
+				std::exception_ptr error;
+				try
+				{
+					m_tasks[id].func();
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					finishTask(id, error);
+				}
+				m_cond.notify_one();
+			});
+			continue;
+		}
+
+		// Also wakes up regularly, so the progress can be animated
+		m_cond.wait_for(lock, 250ms, [&](){ return m_changed; });
+		m_changed = false;
+
+		lock.unlock();
+		onWake();
+		lock.lock();
+	}
+
+	lock.unlock();
+
+	if (callerThread.joinable())
+		callerThread.join();
+
+	// The workers may still be about to notify after finishing their last task
+	m_pool.wait_for_tasks();
+
+	onWake();
+
+	m_tasks.clear();
+
+	if (m_error)
+		std::rethrow_exception(m_error);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#include <BS_thread_pool.hpp>
+
+/*
+ * Runs the tasks of the whole build as a dependency graph.
+ *
+ * Worker tasks run on the pool, never more at once than it has threads.
+ * Caller tasks run one at a time on a thread outside of the pool, so they
+ * may log and may use the pool themselves, while the workers keep going.
+ * */
+class BuildScheduler
+{
+public:
+	using TaskID = std::size_t;
+
+	explicit BuildScheduler(int threadCount);
+
+	// Adds a task that starts once all the tasks it depends on have finished.
+	TaskID addTask(std::function<void()> task, const std::vector<TaskID>& deps, bool onWorker);
+
+	// Wakes up the calling thread of run(), for tasks to report their progress.
+	void notify();
+
+	// Runs all tasks, onWake is called from this thread whenever a task reports
+	// or finishes, also while a caller task runs. After a task throws, no more
+	// tasks are started and the exception is rethrown once the running ones have finished.
+	void run(const std::function<void()>& onWake);
+
+	[[nodiscard]] BS::thread_pool& getPool() { return m_pool; }
+
+private:
+	struct Task
+	{
+		std::function<void()> func;
+		std::vector<TaskID> dependents;
+		std::size_t depsLeft;
+		bool onWorker;
+	};
+
+	BS::thread_pool m_pool;
+	std::vector<Task> m_tasks;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	bool m_changed;
+	std::size_t m_running;
+	bool m_callerRunning;
+	std::size_t m_finished;
+	std::deque<TaskID> m_readyWorkerTasks;
+	std::deque<TaskID> m_readyCallerTasks;
+	std::exception_ptr m_error;
+
+	void finishTask(TaskID id, std::exception_ptr error);
+};
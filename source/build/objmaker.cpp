@@ -1,20 +1,17 @@
 #include "objmaker.hpp"
 
+#include <algorithm>
 #include <fstream>
-#include <thread>
-#include <chrono>
+#include <future>
 #include <unordered_map>
 #include <sstream>
 
-#include <BS_thread_pool.hpp>
-
 #include "../main.hpp"
 #include "../util.hpp"
 #include "../config/buildconfig.hpp"
 #include "../except.hpp"
 #include "../log.hpp"
 #include "../process.hpp"
-#include "buildlogger.hpp"
 
 #include <functional>
 
@@ -29,10 +26,8 @@
 
 namespace fs = std::filesystem;
 
-using namespace std::chrono_literals;
-
 static const char* ExtensionForSourceFileType[] = { ".c", ".cpp", ".s" };
-static const char* CompilerForSourceFileType[] = { "gcc ", "g++ ", "gcc " };
+static const char* CompilerForSourceFileType[] = { "gcc", "g++", "gcc" };
 static const char* DefineForSourceFileType[] = { "__ncp_lang_c", "__ncp_lang_cpp", "__ncp_lang_asm" };
 
 struct SourceFileType {
@@ -41,332 +36,546 @@ struct SourceFileType {
 	};
 };
 
+// Calls func for every index below count, split into a block for each worker of the pool
+template<typename F>
+static void parallelFor(BS::thread_pool& pool, std::size_t count, const F& func)
+{
+	std::size_t blockCount = std::min<std::size_t>(pool.get_thread_count(), count);
+
+	std::vector<std::future<void>> blocks;
+	blocks.reserve(blockCount);
+	for (std::size_t block = 0; block < blockCount; block++)
+	{
+		std::size_t begin = count * block / blockCount;
+		std::size_t end = count * (block + 1) / blockCount;
+		blocks.emplace_back(pool.submit([&func, begin, end](){
+			for (std::size_t i = begin; i < end; i++)
+				func(i);
+		}));
+	}
+
+	// Every block must be done before func goes out of scope, even if one threw
+	for (std::future<void>& block : blocks)
+		block.wait();
+	for (std::future<void>& block : blocks)
+		block.get();
+}
+
 ObjMaker::ObjMaker() = default;
 
-void ObjMaker::makeTarget(
+void ObjMaker::prepareTarget(
 	const BuildTarget& target,
 	const fs::path& targetWorkDir,
 	const fs::path& buildDir,
-	std::vector<std::unique_ptr<SourceFileJob>>& jobs
+	std::vector<std::unique_ptr<SourceFileJob>>& jobs,
+	BS::thread_pool& pool
 	)
 {
 	m_target = &target;
 	m_targetWorkDir = &targetWorkDir;
 	m_buildDir = &buildDir;
 	m_jobs = &jobs;
-
-	fs::path curPath = fs::current_path();
-
-	fs::current_path(*m_targetWorkDir);
+	m_pool = &pool;
 
 	fs::path ncpInclude = Main::getAppPath() / "ncp.h";
 	if (!fs::exists(ncpInclude))
 		throw ncp::file_error(ncpInclude, ncp::file_error::find);
 
-	m_includeFlags.reserve(256);
-	m_includeFlags += "-include\"" + ncpInclude.string() + "\" ";
+	m_includeArgs.clear();
+	m_includeArgs.push_back("-include");
+	m_includeArgs.push_back(ncpInclude.string());
 	for (const fs::path& include : m_target->includes)
-		m_includeFlags += "-I\"" + include.string() + "\" ";
+		m_includeArgs.push_back("-I" + include.string());
 
 	// Build define flags from command line arguments
-	m_defineFlags.clear();
+	m_defineArgs.clear();
 	const std::vector<std::string>& defines = Main::getDefines();
-	for (const std::string& define : defines) {
-		m_defineFlags += "-D";
-		m_defineFlags += define;
-		m_defineFlags += " ";
-	}
+	for (const std::string& define : defines)
+		m_defineArgs.push_back("-D" + define);
+
+	m_database.load(*m_buildDir / (m_target->getArm9() ? "builddb9.bin" : "builddb7.bin"));
 
 	getSourceFiles();
 	checkIfSourcesNeedRebuild();
+}
 
-	bool atLeastOneNeedsRebuild = false;
-	for (std::unique_ptr<SourceFileJob>& srcFile : *m_jobs)
-	{
-		if (!srcFile->rebuild)
-			continue;
-		atLeastOneNeedsRebuild = true;
-	}
-
-	if (atLeastOneNeedsRebuild)
-		compileSources();
-	else
-		Log::out << OBUILD << "Nothing needs building." << std::endl;
-
-	fs::current_path(curPath);
+// Gets the type of a source file from its name, -1 if it is not a source file
+static std::size_t getSourceFileType(std::string_view fileName)
+{
+	// Like path::extension, a name starting with its only dot has no extension
+	std::size_t dotPos = fileName.find_last_of('.');
+	if (dotPos == std::string_view::npos || dotPos == 0)
+		return -1;
+	return Util::indexOf(fileName.substr(dotPos), ExtensionForSourceFileType, 3);
 }
 
 void ObjMaker::getSourceFiles()
 {
+	std::size_t firstJob = m_jobs->size();
+
 	for (const BuildTarget::Region& region : m_target->regions)
 	{
-		for (auto& dir : region.sources)
-		{
-			for (auto& entry : fs::directory_iterator(dir))
+		// The command line only depends on the region and the file type
+		u64 commandHashes[3];
+		bool commandHashSet[3] = { false, false, false };
+
+		// The sources are searched from the target directory without changing into it,
+		// their paths stay relative to it as that is where the compiler is started.
+		// Directories that did not change since the last build are not read again.
+		std::function<void(const fs::path&, bool)> addSourceDir = [&](const fs::path& dir, bool recursive){
+			const BuildDatabase::DirectoryEntry& dirEntry = m_database.getDirectory(*m_targetWorkDir / dir);
+
+			for (const std::string& fileName : dirEntry.files)
 			{
-				if (entry.is_regular_file())
+				std::size_t fileType = getSourceFileType(fileName);
+				if (fileType == -1)
+					continue;
+
+				fs::path srcPath = dir / fileName;
+
+				std::string buildPath = (*m_buildDir / srcPath).string();
+
+				auto srcFile = std::make_unique<SourceFileJob>();
+				srcFile->srcFilePath = srcPath;
+				srcFile->objFilePath = buildPath + ".o";
+				srcFile->depFilePath = buildPath + ".d";
+				srcFile->asmFilePath = buildPath + ".s";
+				srcFile->fileType = fileType;
+				srcFile->region = &region;
+
+				if (!commandHashSet[fileType])
 				{
-					const fs::path& srcPath = entry.path();
-
-					std::size_t fileType = Util::indexOf(srcPath.extension(), ExtensionForSourceFileType, 3);
-					if (fileType == -1)
-						continue;
-
-					std::string buildPath = (*m_buildDir / srcPath).string();
-					fs::path objPath = buildPath + ".o";
-					fs::path depPath = buildPath + ".d";
-					fs::path asmPath = buildPath + ".s";
-
-					bool buildSrc;
-					fs::file_time_type objTime;
-					if (fs::exists(objPath) && !m_target->getForceRebuild())
-					{
-						objTime = fs::last_write_time(objPath);
-						buildSrc = false;
-					}
-					else
-					{
-						buildSrc = true;
-					}
-
-					auto srcFile = std::make_unique<SourceFileJob>();
-					srcFile->srcFilePath = srcPath;
-					srcFile->objFilePath = objPath;
-					srcFile->depFilePath = depPath;
-					srcFile->asmFilePath = asmPath;
-					srcFile->objFileWriteTime = objTime;
-					srcFile->fileType = fileType;
-					srcFile->region = &region;
-					srcFile->rebuild = buildSrc;
-					m_jobs->emplace_back(std::move(srcFile));
+					commandHashes[fileType] = getCommandHash(*srcFile);
+					commandHashSet[fileType] = true;
 				}
+				srcFile->commandHash = commandHashes[fileType];
+
+				m_jobs->emplace_back(std::move(srcFile));
+			}
+
+			if (recursive)
+			{
+				for (const std::string& subdirName : dirEntry.subdirs)
+					addSourceDir(dir / subdirName, true);
 			}
+		};
+
+		for (const BuildTarget::SourceDir& dir : region.sources)
+			addSourceDir(dir.path, dir.recursive);
+	}
+
+	// The objects are looked at in parallel, which matters on a cold cache or a network drive
+	parallelFor(*m_pool, m_jobs->size() - firstJob, [&](std::size_t i){
+		SourceFileJob& srcFile = *(*m_jobs)[firstJob + i];
+
+		// A missing object fails to give its write time
+		std::error_code ec;
+		srcFile.objFileWriteTime = fs::last_write_time(srcFile.objFilePath, ec);
+		srcFile.rebuild = bool(ec);
+	});
+}
+
+// Reads the dependencies listed in a dependency file generated by the compiler
+static bool readDependencies(const fs::path& depFilePath, std::vector<std::string>& deps)
+{
+	std::ifstream depStrm(depFilePath);
+	if (!depStrm.is_open())
+		return false;
+
+	std::string line;
+	while (std::getline(depStrm, line))
+	{
+		std::string_view trimLine;
+		trimLine = line.ends_with('\\') ?
+			std::string_view(line).substr(0, line.find_last_of(' ', line.size() - 1)) :
+			line;
+
+		if (trimLine.starts_with(' '))
+			trimLine = trimLine.substr(1);
+
+		std::string trimLineStr(trimLine);
+		std::string subLine;
+		std::istringstream subStrm(trimLineStr);
+		while (std::getline(subStrm, subLine, ' '))
+		{
+			if (subLine.ends_with(':'))
+				continue;
+#ifdef GCC_HAS_DEP_PATH_BUG
+			std::size_t pathBugPos = subLine.find("\\:");
+			if (pathBugPos != std::string::npos)
+				subLine.erase(subLine.begin() + pathBugPos);
+#endif
+			deps.emplace_back(subLine);
 		}
 	}
+
+	depStrm.close();
+	return true;
+}
+
+// Adds a dependency to the inputs an object is hashed from
+static void appendInputDependency(std::string& inputs, const std::string& depPath, u64 depHash)
+{
+	inputs += depPath;
+	inputs += '\0';
+	inputs.append(reinterpret_cast<const char*>(&depHash), sizeof(depHash));
 }
 
 void ObjMaker::checkIfSourcesNeedRebuild()
 {
-	Log::info("Parsing object file dependencies...");
+	Log::info("Checking object file dependencies...");
 
-	// Fetch dependencies to prevent multiple builds
+	bool hashCheck = BuildConfig::getRebuildCheck() == BuildConfig::RebuildCheck::Hash;
 
-	std::unordered_map<std::string, fs::file_time_type> timeForDep;
+	// The dependencies come from the database instead of the dependency files,
+	// each one is looked at no more than once no matter how many objects list it
 
-	for (std::unique_ptr<SourceFileJob>& srcFile : *m_jobs)
+	enum class DepState : u8 { Unneeded, Needed, Found, Missing };
+	std::size_t pathCount = m_database.getPathCount();
+	std::vector<DepState> depStates(pathCount, DepState::Unneeded);
+	std::vector<fs::file_time_type> depWriteTimes(hashCheck ? 0 : pathCount);
+	std::vector<u64> depHashes(hashCheck ? pathCount : 0);
+	std::vector<u32> neededDeps;
+
+	// If the object is not known, like when it was never built or its build failed,
+	// or was built with another command line, like after its region flags or the defines changed.
+	std::vector<const BuildDatabase::ObjectEntry*> objEntries(m_jobs->size(), nullptr);
+	for (std::size_t i = 0; i < m_jobs->size(); i++)
 	{
+		SourceFileJob& srcFile = *(*m_jobs)[i];
+
 		// Previously set as needing rebuild, no need to check.
-		if (srcFile->rebuild)
+		if (srcFile.rebuild)
 			continue;
 
-		// If the dependency file doesn't exist,
-		// then we can't be sure if the object is up-to-date.
-		if (!fs::exists(srcFile->depFilePath))
+		const BuildDatabase::ObjectEntry* objEntry = m_database.findObject(srcFile.objFilePath.string());
+		if (objEntry == nullptr || objEntry->commandHash != srcFile.commandHash)
 		{
-			srcFile->rebuild = true;
+			srcFile.rebuild = true;
 			continue;
 		}
 
-		std::vector<fs::path> deps;
-
-		// If the dependency file can't be open,
-		// then we can't be sure if the object is up-to-date.
-		std::ifstream depStrm(srcFile->depFilePath);
-		if (!depStrm.is_open())
+		objEntries[i] = objEntry;
+		for (u32 depID : objEntry->deps)
 		{
-			srcFile->rebuild = true;
-			continue;
+			if (depStates[depID] != DepState::Unneeded)
+				continue;
+			depStates[depID] = DepState::Needed;
+			neededDeps.push_back(depID);
 		}
+	}
 
-		std::string line;
-		while (std::getline(depStrm, line))
+	// The dependencies are looked at in parallel, then each object is decided from the results
+	parallelFor(*m_pool, neededDeps.size(), [&](std::size_t i){
+		u32 depID = neededDeps[i];
+
+		// The dependencies are relative to the directory the compiler was started in
+		fs::path dep = *m_targetWorkDir / m_database.getPath(depID);
+
+		bool found;
+		if (hashCheck)
 		{
-			std::string_view trimLine;
-			trimLine = line.ends_with('\\') ?
-				std::string_view(line).substr(0, line.find_last_of(' ', line.size() - 1)) :
-				line;
-
-			if (trimLine.starts_with(' '))
-				trimLine = trimLine.substr(1);
-
-			std::string trimLineStr(trimLine);
-			std::string subLine;
-			std::istringstream subStrm(trimLineStr);
-			while (std::getline(subStrm, subLine, ' '))
-			{
-				if (subLine.ends_with(':'))
-					continue;
-#ifdef GCC_HAS_DEP_PATH_BUG
-				std::size_t pathBugPos = subLine.find("\\:");
-				if (pathBugPos != std::string::npos)
-					subLine.erase(subLine.begin() + pathBugPos);
-#endif
-				deps.emplace_back(subLine);
-			}
+			found = m_database.getFileHash(dep, depHashes[depID]);
 		}
+		else
+		{
+			std::error_code ec;
+			depWriteTimes[depID] = fs::last_write_time(dep, ec);
+			found = !ec;
+		}
+		depStates[depID] = found ? DepState::Found : DepState::Missing;
+	});
 
-		depStrm.close();
+	std::string inputs;
 
-		for (auto& dep : deps)
+	for (std::size_t i = 0; i < m_jobs->size(); i++)
+	{
+		SourceFileJob& srcFile = *(*m_jobs)[i];
+		const BuildDatabase::ObjectEntry* objEntry = objEntries[i];
+		if (objEntry == nullptr)
+			continue;
+
+		if (hashCheck)
 		{
-			if (!fs::exists(dep))
+			// The stored hash of the inputs must match the current one,
+			// the write times are not looked at.
+			inputs.clear();
+			inputs.append(reinterpret_cast<const char*>(&srcFile.commandHash), sizeof(srcFile.commandHash));
+			for (u32 depID : objEntry->deps)
 			{
-				srcFile->rebuild = true;
-				continue;
+				if (depStates[depID] != DepState::Found)
+				{
+					srcFile.rebuild = true;
+					break;
+				}
+				appendInputDependency(inputs, m_database.getPath(depID), depHashes[depID]);
 			}
+			if (srcFile.rebuild)
+				continue;
 
-			std::string depS = dep.string();
-
-			if (!timeForDep.contains(depS))
+			srcFile.inputHash = Util::hash64(inputs.data(), inputs.size());
+			if (srcFile.inputHash != objEntry->inputHash)
 			{
-				fs::file_time_type depT = fs::last_write_time(dep);
-				timeForDep.insert(std::make_pair(depS, depT));
+				srcFile.rebuild = true;
+				continue;
 			}
+			srcFile.inputHashValid = true;
+			continue;
+		}
 
-			fs::file_time_type depFileWriteTime = timeForDep[depS];
-			if (depFileWriteTime > srcFile->objFileWriteTime)
+		for (u32 depID : objEntry->deps)
+		{
+			if (depStates[depID] != DepState::Found || depWriteTimes[depID] > srcFile.objFileWriteTime)
 			{
-				srcFile->rebuild = true;
-				continue;
+				srcFile.rebuild = true;
+				break;
 			}
 		}
 	}
 }
 
-void ObjMaker::compileSources()
+bool ObjMaker::getInputHash(const SourceFileJob& srcFile, u64& hashOut)
 {
-	BS::thread_pool pool(BuildConfig::getThreadCount());
+	// The command line, then the path and content hash of every dependency
+	std::string inputs;
+	inputs.append(reinterpret_cast<const char*>(&srcFile.commandHash), sizeof(srcFile.commandHash));
+	for (const std::string& dep : srcFile.dependencies)
+	{
+		u64 depHash;
+		if (!m_database.getFileHash(*m_targetWorkDir / dep, depHash))
+			return false;
+		appendInputDependency(inputs, dep, depHash);
+	}
 
-	BuildLogger logger;
-	logger.setJobs(*m_jobs);
-	logger.start(*m_targetWorkDir);
+	hashOut = Util::hash64(inputs.data(), inputs.size());
+	return true;
+}
 
-	std::size_t jobID = 0;
-	for (std::unique_ptr<SourceFileJob>& srcFile : *m_jobs)
+u64 ObjMaker::getCommandHash(const SourceFileJob& srcFile) const
+{
+	std::string fingerprint;
+
+	// The input and output files are left out, they are fixed for each object
+	auto addCommand = [&](const std::vector<std::string>& args){
+		for (const std::string& arg : args)
+		{
+			fingerprint += arg;
+			fingerprint += '\0';
+		}
+		fingerprint += '\n';
+	};
+
+	if (getCompileToAsm(srcFile))
+	{
+		addCommand(makeBuildCmd(srcFile, false, true, srcFile.fileType, {}, {}));
+		addCommand(makeBuildCmd(srcFile, false, false, SourceFileType::ASM, {}, {}));
+	}
+	else
+	{
+		addCommand(makeBuildCmd(srcFile, false, false, srcFile.fileType, {}, {}));
+	}
+
+	return Util::hash64(fingerprint.data(), fingerprint.size());
+}
+
+void ObjMaker::saveDatabase()
+{
+	bool hashCheck = BuildConfig::getRebuildCheck() == BuildConfig::RebuildCheck::Hash;
+
+	// Objects that failed or were not built, or whose sources were removed, are left out so they are built again
+	std::vector<std::pair<std::string, BuildDatabase::ObjectEntry>> objects;
+	objects.reserve(m_jobs->size());
+	for (const std::unique_ptr<SourceFileJob>& srcFile : *m_jobs)
 	{
-		if (!srcFile->rebuild)
+		if (srcFile->failed || (srcFile->rebuild && !srcFile->finished))
 			continue;
+		if (hashCheck && !srcFile->inputHashValid)
+			continue;
+
+		std::string objPath = srcFile->objFilePath.string();
 
-		fs::path objDestDir = srcFile->objFilePath.parent_path();
-		if (!fs::exists(objDestDir))
+		BuildDatabase::ObjectEntry objEntry;
+		if (srcFile->rebuild)
 		{
-			if (!fs::create_directories(objDestDir))
-			{
-				std::ostringstream oss;
-				oss << "Could not create object directory: " << OSTR(objDestDir);
-				throw ncp::exception(oss.str());
-			}
+			if (!srcFile->dependenciesValid)
+				continue;
+			objEntry.commandHash = srcFile->commandHash;
+			objEntry.inputHash = srcFile->inputHash;
+			objEntry.deps.reserve(srcFile->dependencies.size());
+			for (const std::string& dep : srcFile->dependencies)
+				objEntry.deps.push_back(m_database.getPathID(dep));
+		}
+		else
+		{
+			const BuildDatabase::ObjectEntry* oldEntry = m_database.findObject(objPath);
+			if (oldEntry == nullptr)
+				continue;
+			objEntry = *oldEntry;
 		}
+		objects.emplace_back(std::move(objPath), std::move(objEntry));
+	}
 
-		srcFile->jobID = jobID++;
-		srcFile->buildStarted = false;
-		srcFile->logWasFinished = false;
-		srcFile->finished = false;
-		srcFile->failed = false;
+	m_database.clearObjects();
+	for (auto& [objPath, objEntry] : objects)
+		m_database.setObject(objPath, std::move(objEntry));
+	m_database.save();
+}
 
-		pool.push_task([&](){
-			srcFile->buildStarted = true;
+void ObjMaker::scheduleTargets(const std::vector<ObjMaker*>& objMakers, BuildScheduler& scheduler, BuildLogger& logger)
+{
+	bool atLeastOneNeedsRebuild = false;
+	for (ObjMaker* objMaker : objMakers)
+	{
+		objMaker->m_compileTasks.clear();
+		for (std::unique_ptr<SourceFileJob>& srcFile : *objMaker->m_jobs)
+		{
+			if (!srcFile->rebuild)
+				continue;
+			atLeastOneNeedsRebuild = true;
+		}
+	}
 
-			std::ostringstream out;
+	if (!atLeastOneNeedsRebuild)
+	{
+		Log::out << OBUILD << "Nothing needs building." << std::endl;
+		return;
+	}
 
-			std::string srcS = srcFile->srcFilePath.string();
-			std::string objS = srcFile->objFilePath.string();
-			std::string depS = srcFile->depFilePath.string();
+	for (ObjMaker* objMaker : objMakers)
+		logger.addJobs(*objMaker->m_jobs, *objMaker->m_targetWorkDir);
 
-			const BuildTarget::Region* region = srcFile->region;
+	std::size_t jobID = 0;
+	for (ObjMaker* objMaker : objMakers)
+	{
+		for (std::unique_ptr<SourceFileJob>& srcFile : *objMaker->m_jobs)
+		{
+			if (!srcFile->rebuild)
+				continue;
 
-			auto makeBuildCmd = [&](
-				bool outputDeps, std::size_t fileType,
-				const std::string& inputFile, const std::string& outputFile)
+			fs::path objDestDir = srcFile->objFilePath.parent_path();
+			if (!fs::exists(objDestDir))
 			{
-				const std::string& flags = [&](){
-					switch (fileType)
-					{
-					case SourceFileType::C:
-						return region->cFlags;
-					case SourceFileType::CPP:
-						return region->cppFlags;
-					case SourceFileType::ASM:
-						return region->asmFlags;
-					default:
-						throw ncp::exception("Tried to get flags of invalid file type.");
-					}
-				}();
-
-				std::string ccmd;
-				ccmd.reserve(256);
-				ccmd += BuildConfig::getToolchain();
-				ccmd += CompilerForSourceFileType[fileType];
-				ccmd += flags;
-				if (fileType != SourceFileType::ASM)
-					ccmd += " -S";
-				ccmd += " -D";
-				ccmd += DefineForSourceFileType[fileType];
-				ccmd += " ";
-				ccmd += m_defineFlags;
-				ccmd += m_includeFlags;
-				ccmd += "-c -fdiagnostics-color -fdata-sections -ffunction-sections ";
-				if (outputDeps)
+				if (!fs::create_directories(objDestDir))
 				{
-					ccmd += "-MMD -MF \"";
-					ccmd += depS;
-					ccmd += "\" ";
+					std::ostringstream oss;
+					oss << "Could not create object directory: " << OSTR(objDestDir);
+					throw ncp::exception(oss.str());
 				}
-				ccmd += "\"";
-				ccmd += inputFile;
-				ccmd += "\" -o \"";
-				ccmd += outputFile;
-				ccmd += "\"";
-				return ccmd;
-			};
-
-			if (srcFile->fileType != SourceFileType::ASM)
-			{
-				std::string asmS = srcFile->asmFilePath.string();
+			}
 
-				std::string ccmd = makeBuildCmd(true, srcFile->fileType, srcS, asmS);
+			srcFile->jobID = jobID++;
+			srcFile->buildStarted = false;
+			srcFile->logWasFinished = false;
+			srcFile->finished = false;
+			srcFile->failed = false;
 
-				int retcode = Process::start(ccmd.c_str(), &out);
+			SourceFileJob* job = srcFile.get();
+			objMaker->m_compileTasks.push_back(scheduler.addTask([objMaker, job, &scheduler](){
+				job->buildStarted = true;
+				scheduler.notify();
+
+				std::ostringstream out;
+				int retcode = objMaker->compileSource(*job, out);
 				if (retcode != 0)
 				{
-					srcFile->failed = true;
+					job->failed = true;
 					out << "Exit code: " << retcode << "\n";
-					srcFile->output = out.str();
-					srcFile->finished = true;
-					return;
 				}
+				else
+				{
+					// The dependency file is only read here, the next builds take the dependencies from the database
+					job->dependencies.clear();
+					job->dependenciesValid = readDependencies(job->depFilePath, job->dependencies);
+					if (job->dependenciesValid && BuildConfig::getRebuildCheck() == BuildConfig::RebuildCheck::Hash)
+						job->inputHashValid = objMaker->getInputHash(*job, job->inputHash);
+				}
+				job->output = out.str();
+				job->finished = true;
+			}, {}, true));
+		}
+	}
 
-				srcS = asmS;
-			}
-
-			std::string ccmd = makeBuildCmd(srcFile->fileType == SourceFileType::ASM, SourceFileType::ASM, srcS, objS);
+	logger.start();
+}
 
-			int retcode = Process::start(ccmd.c_str(), &out);
-			if (retcode != 0)
-			{
-				srcFile->failed = true;
-				out << "Exit code: " << retcode << "\n";
-			}
-			srcFile->output = out.str();
-			srcFile->finished = true;
-		});
+bool ObjMaker::getCompileFailed() const
+{
+	for (const std::unique_ptr<SourceFileJob>& srcFile : *m_jobs)
+	{
+		if (srcFile->failed)
+			return true;
 	}
+	return false;
+}
 
-	auto timeStart = std::chrono::high_resolution_clock::now();
-	while (pool.get_tasks_total() != 0)
-	{
-		auto timeNow = std::chrono::high_resolution_clock::now();
-		if (timeNow >= timeStart + 250ms)
+bool ObjMaker::getCompileToAsm(const SourceFileJob& srcFile) const
+{
+	// C and C++ sources are compiled straight to an object, unless the region asks to keep the assembly
+	return srcFile.fileType != SourceFileType::ASM && srcFile.region->saveAsm;
+}
+
+std::vector<std::string> ObjMaker::makeBuildCmd(
+	const SourceFileJob& srcFile, bool outputDeps, bool outputAsm, std::size_t fileType,
+	const std::string& inputFile, const std::string& outputFile) const
+{
+	const BuildTarget::Region* region = srcFile.region;
+
+	const std::string& flags = [&](){
+		switch (fileType)
 		{
-			logger.update();
-			timeStart = timeNow;
+		case SourceFileType::C:
+			return region->cFlags;
+		case SourceFileType::CPP:
+			return region->cppFlags;
+		case SourceFileType::ASM:
+			return region->asmFlags;
+		default:
+			throw ncp::exception("Tried to get flags of invalid file type.");
 		}
-	}
+	}();
+
+	// The compiler is started directly, so the flags are split here instead of by a shell
+	std::vector<std::string> args;
+	args.reserve(32);
+	args.push_back(BuildConfig::getToolchain() + CompilerForSourceFileType[fileType]);
+	Process::splitArgs(flags, args);
+	if (outputAsm)
+		args.push_back("-S");
+	args.push_back(std::string("-D") + DefineForSourceFileType[fileType]);
+	args.insert(args.end(), m_defineArgs.begin(), m_defineArgs.end());
+	args.insert(args.end(), m_includeArgs.begin(), m_includeArgs.end());
+	args.insert(args.end(), { "-c", "-fdiagnostics-color", "-fdata-sections", "-ffunction-sections" });
+	if (outputDeps)
+		args.insert(args.end(), { "-MMD", "-MF", srcFile.depFilePath.string() });
+	args.insert(args.end(), { inputFile, "-o", outputFile });
+	return args;
+}
+
+int ObjMaker::compileSource(const SourceFileJob& srcFile, std::ostream& out) const
+{
+	std::string srcS = srcFile.srcFilePath.string();
+	std::string objS = srcFile.objFilePath.string();
+	std::string workDirS = m_targetWorkDir->string();
 
-	pool.wait_for_tasks();
+	bool compileToAsm = getCompileToAsm(srcFile);
+
+	if (compileToAsm)
+	{
+		std::string asmS = srcFile.asmFilePath.string();
+
+		std::vector<std::string> args = makeBuildCmd(srcFile, true, true, srcFile.fileType, srcS, asmS);
+
+		int retcode = Process::start(args, &out, workDirS.c_str());
+		if (retcode != 0)
+			return retcode;
+
+		srcS = asmS;
+	}
 
-	logger.finish();
+	std::vector<std::string> args = compileToAsm ?
+		makeBuildCmd(srcFile, false, false, SourceFileType::ASM, srcS, objS) :
+		makeBuildCmd(srcFile, true, false, srcFile.fileType, srcS, objS);
 
-	if (logger.getFailed())
-		throw ncp::exception("Compilation failed.");
+	// The target directory is only the working directory of the compiler, so targets can be built side by side
+	return Process::start(args, &out, workDirS.c_str());
 }
@@ -1,34 +1,61 @@
 #pragma once
 
 #include <memory>
+#include <ostream>
 #include <vector>
+#include <string>
 #include <filesystem>
 
 #include "../config/buildtarget.hpp"
 
 #include "sourcefilejob.hpp"
+#include "buildscheduler.hpp"
+#include "buildlogger.hpp"
+#include "builddatabase.hpp"
 
 class ObjMaker
 {
 public:
 	ObjMaker();
 
-	void makeTarget(
+	// Finds the sources of the target and marks the ones that need to be rebuilt,
+	// the file system is queried from the pool
+	void prepareTarget(
 		const BuildTarget& target,
 		const std::filesystem::path& targetWorkDir,
 		const std::filesystem::path& buildDir,
-		std::vector<std::unique_ptr<SourceFileJob>>& jobs
+		std::vector<std::unique_ptr<SourceFileJob>>& jobs,
+		BS::thread_pool& pool
 	);
 
+	// Adds a worker task for each marked source of the prepared targets,
+	// the logger is started to show their progress if any were added
+	static void scheduleTargets(const std::vector<ObjMaker*>& objMakers, BuildScheduler& scheduler, BuildLogger& logger);
+
+	[[nodiscard]] const std::vector<BuildScheduler::TaskID>& getCompileTasks() const { return m_compileTasks; }
+	[[nodiscard]] bool getCompileFailed() const;
+
+	// Stores what the up-to-date objects were built from
+	void saveDatabase();
+
 private:
 	const BuildTarget* m_target;
 	const std::filesystem::path* m_targetWorkDir;
 	const std::filesystem::path* m_buildDir;
-	std::string m_includeFlags;
-	std::string m_defineFlags;
+	std::vector<std::string> m_includeArgs;
+	std::vector<std::string> m_defineArgs;
 	std::vector<std::unique_ptr<SourceFileJob>>* m_jobs;
+	std::vector<BuildScheduler::TaskID> m_compileTasks;
+	BuildDatabase m_database;
+	BS::thread_pool* m_pool;
 
 	void getSourceFiles();
 	void checkIfSourcesNeedRebuild();
-	void compileSources();
+	bool getInputHash(const SourceFileJob& srcFile, u64& hashOut);
+	u64 getCommandHash(const SourceFileJob& srcFile) const;
+	bool getCompileToAsm(const SourceFileJob& srcFile) const;
+	std::vector<std::string> makeBuildCmd(
+		const SourceFileJob& srcFile, bool outputDeps, bool outputAsm, std::size_t fileType,
+		const std::string& inputFile, const std::string& outputFile) const;
+	int compileSource(const SourceFileJob& srcFile, std::ostream& out) const;
 };
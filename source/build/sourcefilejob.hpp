@@ -2,8 +2,10 @@
 
 #include <cstddef>
 #include <string>
+#include <vector>
 #include <filesystem>
 
+#include "../types.hpp"
 #include "../config/buildtarget.hpp"
 
 class SourceFileJob
@@ -21,6 +23,14 @@ public:
 
 	bool rebuild = false;
 
+	u64 commandHash = 0;
+	u64 inputHash = 0;
+	bool inputHashValid = false;
+
+	// Read from the dependency file once the source was compiled
+	std::vector<std::string> dependencies;
+	bool dependenciesValid = false;
+
 	std::size_t jobID = 0;
 	bool buildStarted = false;
 	bool logWasFinished = false;
@@ -20,6 +20,7 @@ namespace BuildConfig {
 
 static const char* s_loadErr = "Could not load the build configuration.";
 static const char* s_jsonFileName = "ncpatcher.json";
+static const char* s_rebuildCheckStrs[] = { "time", "hash" };
 
 struct TargetConfig
 {
@@ -37,6 +38,7 @@ static TargetConfig arm9Config;
 static std::vector<std::string> preBuildCmds;
 static std::vector<std::string> postBuildCmds;
 static int threadCount;
+static RebuildCheck rebuildCheck;
 static std::time_t lastWriteTime;
 
 static void expandTemplates(std::string& val)
@@ -107,6 +109,25 @@ static void readTargetFromJson(JsonReader& json, bool arm9, TargetConfig& out)
 	}
 }
 
+static void readRebuildCheck(const JsonReader& json)
+{
+	if (json.hasMember("rebuild-check"))
+	{
+		const char* checkStr = json["rebuild-check"].getString();
+		size_t index = Util::indexOf(checkStr, s_rebuildCheckStrs, 2);
+		if (index != size_t(-1))
+		{
+			rebuildCheck = static_cast<RebuildCheck>(index);
+			return;
+		}
+
+		std::ostringstream oss;
+		oss << "Invalid rebuild check " << OSTR(checkStr) << " in " << OSTR(s_jsonFileName);
+		throw ncp::exception(oss.str());
+	}
+	rebuildCheck = RebuildCheck::Time;
+}
+
 static void readBuildCommands(const JsonMember& member, std::vector<std::string>& cmdsOut)
 {
 	size_t size = member.size();
@@ -124,6 +145,13 @@ void load()
 
 	JsonReader json(jsonPath);
 
+	// The configuration may be loaded again in watch mode
+	varmap.clear();
+	arm7Config = TargetConfig();
+	arm9Config = TargetConfig();
+	preBuildCmds.clear();
+	postBuildCmds.clear();
+
 	varmap.emplace("root", Main::getWorkPath().string());
 
 	std::vector<JsonMember> members = json.getMembers();
@@ -148,6 +176,7 @@ void load()
 	readBuildCommands(json["post-build"], postBuildCmds);
 
 	threadCount = json["thread-count"].getInt();
+	readRebuildCheck(json);
 
 	lastWriteTime = Util::toTimeT(fs::last_write_time(jsonPath));
 
@@ -181,6 +210,7 @@ const std::vector<std::string>& getPreBuildCmds() { return preBuildCmds; }
 const std::vector<std::string>& getPostBuildCmds() { return postBuildCmds; }
 
 int getThreadCount() { return threadCount; }
+RebuildCheck getRebuildCheck() { return rebuildCheck; }
 std::time_t getLastWriteTime() { return lastWriteTime; }
 
 }
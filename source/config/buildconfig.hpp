@@ -6,6 +6,12 @@
 
 namespace BuildConfig {
 
+enum class RebuildCheck
+{
+	Time = 0, // Rebuild when a dependency is newer than the object
+	Hash      // Rebuild when the contents of the dependencies or the flags changed
+};
+
 void load();
 
 const std::string& getVariable(const std::string& value);
@@ -26,6 +32,7 @@ const std::vector<std::string>& getPreBuildCmds();
 const std::vector<std::string>& getPostBuildCmds();
 
 int getThreadCount();
+RebuildCheck getRebuildCheck();
 std::time_t getLastWriteTime();
 
 }
@@ -16,6 +16,7 @@ namespace rj = rapidjson;
 using varmap_t = std::unordered_map<std::string, std::string>;
 
 static const char* s_regionModeStrs[] = { "append", "replace", "create" };
+static const char* s_compressModeStrs[] = { "fast", "best" };
 
 BuildTarget::BuildTarget() = default;
 
@@ -61,13 +62,15 @@ void BuildTarget::load(const fs::path& targetFilePath, bool isArm9)
 	for (JsonMember& regionObj : regionObjs)
 	{
 		Region region;
-		getDirectoryArray(regionObj["sources"], region.sources);
+		getSourceDirArray(regionObj["sources"], region.sources);
 		readDestination(region, regionObj["dest"]);
 		region.compress = regionObj["compress"].getBool();
+		readCompressMode(region, regionObj);
 		region.cFlags = regionObj.hasMember("c_flags") ? getString(regionObj["c_flags"]) : cFlags;
 		region.cppFlags = regionObj.hasMember("cpp_flags") ? getString(regionObj["cpp_flags"]) : cppFlags;
 		region.asmFlags = regionObj.hasMember("asm_flags") ? getString(regionObj["asm_flags"]) : asmFlags;
 		//region.ldFlags = regionObj.hasMember("ld_flags") ? getString(regionObj["ld_flags"]) : ldFlags;
+		region.saveAsm = regionObj.hasMember("save_asm") && regionObj["save_asm"].getBool();
 		readRegionMode(region, regionObj);
 		if (region.mode == Mode::Replace)
 			region.address = regionObj.hasMember("address") ? regionObj["address"].getInt() : 0xFFFFFFFF;
@@ -187,6 +190,24 @@ void BuildTarget::getDirectoryArray(const JsonMember& member, std::vector<fs::pa
 	}
 }
 
+void BuildTarget::getSourceDirArray(const JsonMember& member, std::vector<SourceDir>& out)
+{
+	size_t size = member.size();
+	for (size_t i = 0; i < size; i++)
+	{
+		JsonMember info = member[i];
+		fs::path path = getString(info[size_t(0)]);
+		path.make_preferred();
+		if (!fs::exists(path))
+		{
+			Log::out << OWARN << "Ignored non-existent directory: " << OSTR(path.string()) << std::endl;
+			continue;
+		}
+
+		out.push_back(SourceDir{ path, info[1].getBool() });
+	}
+}
+
 void BuildTarget::readDestination(BuildTarget::Region& region, const JsonMember& member)
 {
 	const char* destStr = member.getString();
@@ -227,6 +248,25 @@ void BuildTarget::readRegionMode(BuildTarget::Region& region, const JsonMember&
 	region.mode = BuildTarget::Mode::Append;
 }
 
+void BuildTarget::readCompressMode(BuildTarget::Region& region, const JsonMember& member)
+{
+	if (member.hasMember("compress_mode"))
+	{
+		const char* modeStr = member["compress_mode"].getString();
+		size_t index = Util::indexOf(modeStr, s_compressModeStrs, 2);
+		if (index != size_t(-1))
+		{
+			region.compressMode = static_cast<BLZ::CompressMode>(index);
+			return;
+		}
+
+		std::ostringstream oss;
+		oss << "Invalid compress mode " << OSTR(modeStr) << ".";
+		throw ncp::exception(oss.str());
+	}
+	region.compressMode = BLZ::CompressMode::Fast;
+}
+
 void BuildTarget::readOverwrites(BuildTarget::Region& region, const JsonMember& member)
 {
 	if (member.hasMember("overwrites"))
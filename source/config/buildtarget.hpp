@@ -7,6 +7,7 @@
 
 #include "json.hpp"
 #include "../types.hpp"
+#include "../blz.hpp"
 
 class BuildTarget
 {
@@ -24,18 +25,26 @@ public:
 		u32 endAddress;
 	};
 
+	struct SourceDir
+	{
+		std::filesystem::path path;
+		bool recursive; // The subdirectories are searched by the ObjMaker
+	};
+
 	struct Region
 	{
-		std::vector<std::filesystem::path> sources;
+		std::vector<SourceDir> sources;
 		int destination;
 		Mode mode;
 		bool compress;
+		BLZ::CompressMode compressMode;
 		u32 address;
 		int length;
 		std::string cFlags;
 		std::string cppFlags;
 		std::string asmFlags;
 		//std::string ldFlags;
+		bool saveAsm;
 		std::vector<Overwrites> overwrites;
 	};
 
@@ -50,10 +59,7 @@ public:
 	std::string ldFlags;
 
 	[[nodiscard]] constexpr bool getArm9() const { return m_isArm9; }
-	[[nodiscard]] constexpr std::time_t getLastWriteTime() { return m_lastWriteTime; }
-	[[nodiscard]] constexpr bool getForceRebuild() const { return m_forceRebuild; }
-
-	constexpr void setForceRebuild(bool forceRebuild) { m_forceRebuild = forceRebuild; }
+	[[nodiscard]] constexpr std::time_t getLastWriteTime() const { return m_lastWriteTime; }
 
 	BuildTarget();
 	void load(const std::filesystem::path& targetFilePath, bool isArm9);
@@ -64,11 +70,12 @@ private:
 	std::string getString(const JsonMember& member);
 	static void addPathRecursively(const std::filesystem::path& path, std::vector<std::filesystem::path>& out);
 	void getDirectoryArray(const JsonMember& member, std::vector<std::filesystem::path>& out);
+	void getSourceDirArray(const JsonMember& member, std::vector<SourceDir>& out);
 	static void readDestination(BuildTarget::Region& region, const JsonMember& member);
 	static void readRegionMode(BuildTarget::Region& region, const JsonMember& member);
+	static void readCompressMode(BuildTarget::Region& region, const JsonMember& member);
 	void readOverwrites(BuildTarget::Region& region, const JsonMember& member);
 
 	bool m_isArm9{};
 	std::time_t m_lastWriteTime;
-	bool m_forceRebuild;
 };
@@ -18,6 +18,8 @@ static std::time_t arm9TargetWriteTime;
 static std::vector<u32> arm7PatchedOvs;
 static std::vector<u32> arm9PatchedOvs;
 static std::vector<std::string> defines;
+static u64 arm7PatchFingerprint;
+static u64 arm9PatchFingerprint;
 
 void load()
 {
@@ -30,6 +32,11 @@ void load()
 		buildConfigWriteTime = std::numeric_limits<std::time_t>::max();
 		arm7TargetWriteTime = std::numeric_limits<std::time_t>::max();
 		arm9TargetWriteTime = std::numeric_limits<std::time_t>::max();
+		arm7PatchedOvs.clear();
+		arm9PatchedOvs.clear();
+		defines.clear();
+		arm7PatchFingerprint = 0;
+		arm9PatchFingerprint = 0;
 		fs::current_path(curPath);
 		return;
 	}
@@ -92,6 +99,18 @@ void load()
 		defines.push_back(std::move(define));
 	}
 
+	// Files written before the fingerprints were added do not have them
+	if (curDataPtr + 2 * sizeof(u64) <= pData + inputFileSize)
+	{
+		arm7PatchFingerprint = read.template operator()<u64>();
+		arm9PatchFingerprint = read.template operator()<u64>();
+	}
+	else
+	{
+		arm7PatchFingerprint = 0;
+		arm9PatchFingerprint = 0;
+	}
+
 	fs::current_path(curPath);
 }
 
@@ -112,7 +131,7 @@ void save()
 	}
 
 	std::vector<u8> data;
-	std::size_t dataSize = (3 * sizeof(std::time_t)) + 12 + (arm7PatchedOvCount * 4) + (arm9PatchedOvCount * 4) + definesSize;
+	std::size_t dataSize = (3 * sizeof(std::time_t)) + 12 + (arm7PatchedOvCount * 4) + (arm9PatchedOvCount * 4) + definesSize + (2 * sizeof(u64));
 	data.resize(dataSize);
 	u8* pData = data.data();
 
@@ -142,6 +161,9 @@ void save()
 		curDataPtr += define.length();
 	}
 
+	write.template operator()<u64>(arm7PatchFingerprint);
+	write.template operator()<u64>(arm9PatchFingerprint);
+
 	std::ofstream outputFile(rebFile, std::ios::binary);
 	if (!outputFile.is_open())
 		throw ncp::file_error(rebFile, ncp::file_error::write);
@@ -157,10 +179,14 @@ std::time_t getArm9TargetWriteTime() { return arm9TargetWriteTime; }
 std::vector<u32>& getArm7PatchedOvs() { return arm7PatchedOvs; }
 std::vector<u32>& getArm9PatchedOvs() { return arm9PatchedOvs; }
 const std::vector<std::string>& getDefines() { return defines; }
+u64 getArm7PatchFingerprint() { return arm7PatchFingerprint; }
+u64 getArm9PatchFingerprint() { return arm9PatchFingerprint; }
 
 void setBuildConfigWriteTime(std::time_t value) { buildConfigWriteTime = value; }
 void setArm7TargetWriteTime(std::time_t value) { arm7TargetWriteTime = value; }
 void setArm9TargetWriteTime(std::time_t value) { arm9TargetWriteTime = value; }
 void setDefines(const std::vector<std::string>& value) { defines = value; }
+void setArm7PatchFingerprint(u64 value) { arm7PatchFingerprint = value; }
+void setArm9PatchFingerprint(u64 value) { arm9PatchFingerprint = value; }
 
 }
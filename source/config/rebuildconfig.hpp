@@ -17,10 +17,14 @@ std::time_t getArm9TargetWriteTime();
 std::vector<u32>& getArm7PatchedOvs();
 std::vector<u32>& getArm9PatchedOvs();
 const std::vector<std::string>& getDefines();
+u64 getArm7PatchFingerprint();
+u64 getArm9PatchFingerprint();
 
 void setBuildConfigWriteTime(std::time_t value);
 void setArm7TargetWriteTime(std::time_t value);
 void setArm9TargetWriteTime(std::time_t value);
 void setDefines(const std::vector<std::string>& defines);
+void setArm7PatchFingerprint(u64 value);
+void setArm9PatchFingerprint(u64 value);
 
 }
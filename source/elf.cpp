@@ -2,23 +2,72 @@
 
 #include <fstream>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 Elf32::Elf32() :
-	dataptr(nullptr)
+	dataptr(nullptr),
+	datasize(0),
+	mapped(false)
 {}
 
 Elf32::~Elf32()
 {
-	delete[] dataptr;
+	unload();
 }
 
 bool Elf32::load(const std::filesystem::path& elf)
 {
+	unload();
+
+#ifndef _WIN32
+	// Map the file when possible, the objects are only ever read
+	int fd = open(elf.c_str(), O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+	{
+		void* addr = mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED)
+		{
+			close(fd);
+			dataptr = static_cast<const char*>(addr);
+			datasize = std::size_t(st.st_size);
+			mapped = true;
+			return true;
+		}
+	}
+	close(fd);
+#endif
+
 	std::uintmax_t fs = std::filesystem::file_size(elf);
 	std::ifstream ef(elf, std::ios::binary);
 	if (!ef.is_open())
 		return false;
-	dataptr = new char[fs];
-	ef.read(dataptr, std::streamsize(fs));
+	char* data = new char[fs];
+	ef.read(data, std::streamsize(fs));
 	ef.close();
+	dataptr = data;
+	datasize = std::size_t(fs);
 	return true;
 }
+
+void Elf32::unload()
+{
+#ifndef _WIN32
+	if (mapped)
+		munmap(const_cast<char*>(dataptr), datasize);
+	else
+#endif
+		delete[] dataptr;
+
+	dataptr = nullptr;
+	datasize = 0;
+	mapped = false;
+}
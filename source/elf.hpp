@@ -128,6 +128,10 @@ public:
 
 	bool load(const std::filesystem::path& elf);
 
+	void unload(); // Invalidates every pointer into the file data
+
+	[[nodiscard]] constexpr std::size_t getSize() const { return datasize; }
+
 	[[nodiscard]] inline const Elf32_Ehdr& getHeader() const {
 		return *reinterpret_cast<const Elf32_Ehdr*>(dataptr);
 	};
@@ -146,5 +150,7 @@ public:
 	}
 
 private:
-	char* dataptr;
+	const char* dataptr;
+	std::size_t datasize;
+	bool mapped;
 };
@@ -0,0 +1,301 @@
+#include "filewatcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "util.hpp"
+#include "except.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+namespace fs = std::filesystem;
+
+using namespace std::chrono_literals;
+
+#ifdef __linux__
+constexpr u32 WatchMask =
+	IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+#else
+// The write time and size of a file, both -1 if it does not exist
+static std::pair<s64, u64> getStamp(const fs::directory_entry& entry)
+{
+	std::error_code ec;
+	s64 writeTime = s64(entry.last_write_time(ec).time_since_epoch().count());
+	if (ec)
+		return { -1, u64(-1) };
+	u64 size = entry.is_directory(ec) ? 0 : u64(entry.file_size(ec));
+	return { writeTime, size };
+}
+
+#endif
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+	m_fd = inotify_init1(IN_CLOEXEC);
+	if (m_fd == -1)
+		throw ncp::exception("Could not start watching for file changes.");
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	close(m_fd);
+#endif
+}
+
+void FileWatcher::beginUpdate()
+{
+	for (auto& [key, dir] : m_dirs)
+	{
+		dir.used = false;
+		dir.usedFileNames.clear();
+		dir.usedAllFiles = false;
+	}
+#ifndef __linux__
+	// Write times can not be compared to the current time, they may lag behind it
+	m_updateStamps.clear();
+	forEachFile([this](const fs::directory_entry& entry){
+		m_updateStamps.emplace(entry.path().string(), getStamp(entry));
+	});
+	for (const auto& [dirPath, dir] : m_dirs)
+	{
+		if (dir.allFiles)
+		{
+			std::error_code ec;
+			m_updateStamps.emplace(dir.path.string(), getStamp(fs::directory_entry(dir.path, ec)));
+		}
+	}
+#endif
+}
+
+void FileWatcher::endUpdate()
+{
+	for (auto it = m_dirs.begin(); it != m_dirs.end();)
+	{
+		WatchedDir& dir = it->second;
+		if (!dir.used)
+		{
+#ifdef __linux__
+			inotify_rm_watch(m_fd, it->first);
+#endif
+			it = m_dirs.erase(it);
+			continue;
+		}
+		dir.fileNames = std::move(dir.usedFileNames);
+		dir.allFiles = dir.usedAllFiles;
+		++it;
+	}
+}
+
+FileWatcher::WatchedDir* FileWatcher::getWatchedDir(const fs::path& path)
+{
+#ifdef __linux__
+	// Adding the same directory again gives back the same watch
+	int wd = inotify_add_watch(m_fd, path.c_str(), WatchMask);
+	if (wd == -1)
+		return nullptr;
+	auto [it, inserted] = m_dirs.try_emplace(wd);
+#else
+	std::error_code ec;
+	if (!fs::is_directory(path, ec))
+		return nullptr;
+	auto [it, inserted] = m_dirs.try_emplace(path.string());
+#endif
+	if (inserted)
+	{
+		it->second.path = path;
+		it->second.allFiles = false;
+		it->second.usedAllFiles = false;
+	}
+	it->second.used = true;
+	return &it->second;
+}
+
+void FileWatcher::addFile(const fs::path& path)
+{
+	WatchedDir* dir = getWatchedDir(path.parent_path());
+	if (dir == nullptr)
+		return;
+
+	// Until endUpdate(), the files watched before stay watched too
+	std::string fileName = path.filename().string();
+	if (std::find(dir->fileNames.begin(), dir->fileNames.end(), fileName) == dir->fileNames.end())
+		dir->fileNames.push_back(fileName);
+	if (std::find(dir->usedFileNames.begin(), dir->usedFileNames.end(), fileName) == dir->usedFileNames.end())
+		dir->usedFileNames.push_back(std::move(fileName));
+}
+
+void FileWatcher::addDirectory(const fs::path& path, bool recursive)
+{
+	WatchedDir* dir = getWatchedDir(path);
+	if (dir == nullptr)
+		return;
+	dir->allFiles = true;
+	dir->usedAllFiles = true;
+
+	if (!recursive)
+		return;
+
+	// A directory created later is seen as a change of its parent, it is added on the next build
+	std::error_code ec;
+	for (const fs::directory_entry& entry : fs::directory_iterator(path, ec))
+	{
+		if (entry.is_directory(ec))
+			addDirectory(entry.path(), true);
+	}
+}
+
+#ifdef __linux__
+
+bool FileWatcher::readEvents(bool block)
+{
+	alignas(inotify_event) char buffer[4096];
+
+	pollfd pfd = { m_fd, POLLIN, 0 };
+	int ready = poll(&pfd, 1, block ? -1 : 100);
+	if (ready == -1 && errno != EINTR)
+		throw ncp::exception("Could not wait for file changes.");
+	if (ready <= 0)
+		return false;
+
+	ssize_t length = read(m_fd, buffer, sizeof(buffer));
+	if (length == -1)
+	{
+		if (errno == EINTR || errno == EAGAIN)
+			return false;
+		throw ncp::exception("Could not wait for file changes.");
+	}
+
+	bool changed = false;
+	for (ssize_t pos = 0; pos < length;)
+	{
+		const auto* event = reinterpret_cast<const inotify_event*>(&buffer[pos]);
+		pos += ssize_t(sizeof(inotify_event) + event->len);
+
+		// Events were dropped, so anything may have changed
+		if (event->mask & IN_Q_OVERFLOW)
+		{
+			changed = true;
+			continue;
+		}
+
+		auto it = m_dirs.find(event->wd);
+		if (it == m_dirs.end() || (event->mask & IN_IGNORED))
+			continue;
+
+		const WatchedDir& dir = it->second;
+		if (dir.allFiles || event->len == 0)
+		{
+			changed = true;
+			continue;
+		}
+
+		std::string_view fileName(event->name);
+		if (std::find(dir.fileNames.begin(), dir.fileNames.end(), fileName) != dir.fileNames.end())
+			changed = true;
+	}
+	return changed;
+}
+
+void FileWatcher::waitForChange()
+{
+	while (!readEvents(true));
+
+	// Whatever comes in right after belongs to the same change
+	while (true)
+	{
+		pollfd pfd = { m_fd, POLLIN, 0 };
+		int ready = poll(&pfd, 1, 100);
+		if (ready == 0)
+			break;
+		if (ready == -1 && errno != EINTR)
+			throw ncp::exception("Could not wait for file changes.");
+		readEvents(false);
+	}
+}
+
+#else
+
+void FileWatcher::forEachFile(const std::function<void(const fs::directory_entry&)>& func) const
+{
+	for (const auto& [dirPath, dir] : m_dirs)
+	{
+		std::error_code ec;
+		if (dir.allFiles)
+		{
+			for (const fs::directory_entry& entry : fs::directory_iterator(dir.path, ec))
+				func(entry);
+		}
+		else
+		{
+			for (const std::string& fileName : dir.fileNames)
+			{
+				fs::directory_entry entry(dir.path / fileName, ec);
+				if (entry.exists(ec))
+					func(entry);
+			}
+		}
+	}
+}
+
+u64 FileWatcher::getState() const
+{
+	// The names, sizes and write times of all watched files
+	std::string state;
+	for (const auto& [dirPath, dir] : m_dirs)
+	{
+		state += dirPath;
+		state += '\n';
+	}
+
+	forEachFile([&state](const fs::directory_entry& entry){
+		auto [writeTime, size] = getStamp(entry);
+		state += entry.path().string();
+		state += '\0';
+		state.append(reinterpret_cast<const char*>(&writeTime), sizeof(writeTime));
+		state.append(reinterpret_cast<const char*>(&size), sizeof(size));
+	});
+
+	return Util::hash64(state.data(), state.size());
+}
+
+bool FileWatcher::getChangedSinceUpdate() const
+{
+	// A directory gets a new write time whenever a file is added, removed or renamed in it
+	for (const auto& [path, stamp] : m_updateStamps)
+	{
+		std::error_code ec;
+		if (getStamp(fs::directory_entry(path, ec)) != stamp)
+			return true;
+	}
+	return false;
+}
+
+void FileWatcher::waitForChange()
+{
+	// Files changed while building may have been read before they changed
+	u64 state = getState();
+	if (!getChangedSinceUpdate())
+	{
+		while (getState() == state)
+			std::this_thread::sleep_for(500ms);
+	}
+
+	// Keep waiting while the files are still being written
+	do
+	{
+		state = getState();
+		std::this_thread::sleep_for(200ms);
+	}
+	while (getState() != state);
+}
+
+#endif
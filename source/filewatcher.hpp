@@ -0,0 +1,71 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+
+#include "types.hpp"
+
+/*
+ * Waits for changes to the files a build was made from.
+ *
+ * On Linux the directories are watched with inotify,
+ * on other systems their contents are polled.
+ * */
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// Starts adding again what is watched, changes to what was watched
+	// before keep being reported, so nothing is missed while building.
+	void beginUpdate();
+
+	// Stops watching what was not added again since beginUpdate().
+	void endUpdate();
+
+	// Watches a single file, it may also be replaced or created later.
+	void addFile(const std::filesystem::path& path);
+
+	// Watches every file directly in the directory, and in its subdirectories if recursive.
+	void addDirectory(const std::filesystem::path& path, bool recursive);
+
+	// Blocks until something watched changes, then returns once
+	// no more changes came in for a moment, like while saving several files.
+	void waitForChange();
+
+private:
+	struct WatchedDir
+	{
+		std::filesystem::path path;
+		std::vector<std::string> fileNames; // Only these files are watched, unless allFiles is set
+		bool allFiles;
+		bool used; // Added again since beginUpdate(), with the following
+		std::vector<std::string> usedFileNames;
+		bool usedAllFiles;
+	};
+
+	// Returns nullptr if the directory can not be watched, like when it does not exist
+	WatchedDir* getWatchedDir(const std::filesystem::path& path);
+
+#ifdef __linux__
+	int m_fd;
+	std::unordered_map<int, WatchedDir> m_dirs;
+
+	bool readEvents(bool block);
+#else
+	std::unordered_map<std::string, WatchedDir> m_dirs;
+	std::unordered_map<std::string, std::pair<s64, u64>> m_updateStamps; // Of the watched files and directories when the update began
+
+	void forEachFile(const std::function<void(const std::filesystem::directory_entry&)>& func) const;
+	u64 getState() const;
+	bool getChangedSinceUpdate() const;
+#endif
+};
@@ -31,6 +31,8 @@ namespace Log {
 
 static std::ofstream logFile;
 static LogMode logMode = LogMode::Both;
+static bool deferOutput = false;
+static std::string deferredOutput;
 static bool xyCapabilityAvailable = true;
 
 #ifdef _WIN32
@@ -71,7 +73,10 @@ public:
 
 	int sync() override
 	{
-		flushBuffer(str());
+		if (deferOutput)
+			deferredOutput += str();
+		else
+			flushBuffer(str());
 		str("");
 		return 0; // Always return success
 	}
@@ -328,6 +333,20 @@ void setMode(LogMode mode)
 	logMode = mode;
 }
 
+void setDeferred(bool deferred)
+{
+	out << std::flush;
+	deferOutput = deferred;
+}
+
+std::string takeDeferred()
+{
+	out << std::flush;
+	std::string output = std::move(deferredOutput);
+	deferredOutput.clear();
+	return output;
+}
+
 #ifdef _WIN32
 
 Coords getXY()
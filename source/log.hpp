@@ -109,6 +109,12 @@ void error(const std::string& str);
 
 void setMode(LogMode mode);
 
+// While deferred, the output is held back instead of being written.
+void setDeferred(bool deferred);
+
+// Returns the output that was held back and forgets it.
+std::string takeDeferred();
+
 // Gets the cursor position on the console.
 Coords getXY();
 
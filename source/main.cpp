@@ -1,6 +1,8 @@
 #include "main.hpp"
 
 #include <vector>
+#include <memory>
+#include <ctime>
 #include <filesystem>
 #include <sstream>
 
@@ -15,7 +17,10 @@
 #include "ndsbin/armbin.hpp"
 #include "build/sourcefilejob.hpp"
 #include "build/objmaker.hpp"
+#include "build/buildscheduler.hpp"
+#include "build/buildlogger.hpp"
 #include "patch/patchmaker.hpp"
+#include "filewatcher.hpp"
 
 #ifdef _WIN32
 #ifndef NOMINMAX
@@ -40,6 +45,7 @@ static std::filesystem::path s_workPath;
 static std::filesystem::path s_romPath;
 static const char* s_errorContext = nullptr;
 static bool s_verbose = false;
+static bool s_watch = false;
 static std::vector<std::string> s_defines;
 
 const std::filesystem::path& getAppPath() { return s_appPath; }
@@ -63,6 +69,8 @@ static void printHelp()
 	Log::out << "  -h, --help       Show this help message and exit" << std::endl;
 	Log::out << "  -v, --verbose    Enable verbose logging output" << std::endl;
 	Log::out << "  --define VALUE   Define a preprocessor macro for compilation" << std::endl;
+	Log::out << "  --watch          Keep running and build again whenever a source," << std::endl;
+	Log::out << "                   header or configuration file changes" << std::endl;
 	Log::out << std::endl;
 	Log::out << "Description:" << std::endl;
 	Log::out << "  NCPatcher is a tool for patching Nintendo DS ROMs by compiling" << std::endl;
@@ -72,10 +80,14 @@ static void printHelp()
 	Log::out << "  directory and processes ARM7/ARM9 targets as specified." << std::endl;
 }
 
-static void ncpMain()
+// The watcher is given in watch mode, the files the build depends on are added to it as they are found
+static void ncpMain(FileWatcher* watcher)
 {
 	Log::out << ANSI_bWHITE " ----- Nitro Code Patcher -----" ANSI_RESET << std::endl;
 
+	if (watcher)
+		watcher->addFile(Main::getWorkPath() / "ncpatcher.json");
+
 	BuildConfig::load();
 	RebuildConfig::load();
 
@@ -95,48 +107,88 @@ static void ncpMain()
 	HeaderBin header;
 	header.load(Main::s_romPath / "header.bin");
 
-	bool forceRebuild = false;
+	struct TargetWork
+	{
+		bool isArm9;
+		BuildTarget buildTarget;
+		fs::path targetDir;
+		fs::path buildPath;
+		std::time_t lastTargetWriteTimeNew;
+		std::vector<std::unique_ptr<SourceFileJob>> srcFileJobs;
+		ObjMaker objMaker;
+	};
+
+	// One pool does all the parallel work of the build, so the thread count is respected globally
+	BuildScheduler scheduler(BuildConfig::getThreadCount());
+	BuildLogger logger;
 
-	auto doWorkOnTarget = [&](bool isArm9){
-		fs::current_path(Main::getWorkPath());
+	auto prepareTarget = [&](bool isArm9){
+		auto work = std::make_unique<TargetWork>();
+		work->isArm9 = isArm9;
 
 		Log::info(isArm9 ?
 			"Loading ARM9 target configuration..." :
 			"Loading ARM7 target configuration...");
 
-		const fs::path& targetPath = fs::absolute(isArm9 ? BuildConfig::getArm9Target() : BuildConfig::getArm7Target());
+		fs::path targetPath = Main::getWorkPath() / (isArm9 ? BuildConfig::getArm9Target() : BuildConfig::getArm7Target());
 
 		Main::setErrorContext(isArm9 ?
 			"Could not load the ARM9 target configuration." :
 			"Could not load the ARM7 target configuration.");
-		BuildTarget buildTarget;
+		if (watcher)
+			watcher->addFile(targetPath);
+		BuildTarget& buildTarget = work->buildTarget;
 		buildTarget.load(targetPath, isArm9);
 		Main::setErrorContext(nullptr);
 
-		std::time_t lastTargetWriteTimeNew = buildTarget.getLastWriteTime();
-		std::time_t lastTargetWriteTimeOld = isArm9 ?
-			RebuildConfig::getArm9TargetWriteTime() :
-			RebuildConfig::getArm7TargetWriteTime();
-		buildTarget.setForceRebuild(forceRebuild || (lastTargetWriteTimeNew > lastTargetWriteTimeOld));
+		// Changed flags or defines no longer rebuild the whole target,
+		// every object compares the command it was built with instead
+		work->lastTargetWriteTimeNew = buildTarget.getLastWriteTime();
 
 		Main::setErrorContext(isArm9 ?
 			"Could not compile the ARM9 target." :
 			"Could not compile the ARM7 target.");
 
-		fs::path targetDir = targetPath.parent_path();
-		fs::path buildPath = fs::absolute(isArm9 ? BuildConfig::getArm9BuildDir() : BuildConfig::getArm7BuildDir());
+		// Every path is absolute, so the targets never depend on the current directory
+		work->targetDir = targetPath.parent_path();
+		work->buildPath = Main::getWorkPath() / (isArm9 ? BuildConfig::getArm9BuildDir() : BuildConfig::getArm7BuildDir());
 
-		std::vector<std::unique_ptr<SourceFileJob>> srcFileJobs;
+		if (watcher)
+		{
+			for (const BuildTarget::Region& region : buildTarget.regions)
+			{
+				for (const BuildTarget::SourceDir& dir : region.sources)
+					watcher->addDirectory(work->targetDir / dir.path, dir.recursive);
+			}
+			// The include directories were already expanded if they are searched recursively
+			for (const fs::path& include : buildTarget.includes)
+				watcher->addDirectory(work->targetDir / include, false);
+			if (!buildTarget.symbols.empty())
+				watcher->addFile(work->targetDir / buildTarget.symbols);
+		}
 
-		ObjMaker objMaker;
-		objMaker.makeTarget(buildTarget, targetDir, buildPath, srcFileJobs);
+		work->objMaker.prepareTarget(buildTarget, work->targetDir, work->buildPath, work->srcFileJobs, scheduler.getPool());
+
+		Main::setErrorContext(nullptr);
+		return work;
+	};
+
+	auto patchTarget = [&](TargetWork& work){
+		Main::setErrorContext(work.isArm9 ?
+			"Could not compile the ARM9 target." :
+			"Could not compile the ARM7 target.");
+
+		work.objMaker.saveDatabase();
+
+		if (work.objMaker.getCompileFailed())
+			throw ncp::exception("Compilation failed.");
 
 		PatchMaker patchMaker;
-		patchMaker.makeTarget(buildTarget, targetDir, buildPath, header, srcFileJobs);
+		patchMaker.makeTarget(work.buildTarget, work.targetDir, work.buildPath, header, work.srcFileJobs, scheduler.getPool());
 
-		isArm9 ?
-			RebuildConfig::setArm9TargetWriteTime(lastTargetWriteTimeNew) :
-			RebuildConfig::setArm7TargetWriteTime(lastTargetWriteTimeNew);
+		work.isArm9 ?
+			RebuildConfig::setArm9TargetWriteTime(work.lastTargetWriteTimeNew) :
+			RebuildConfig::setArm7TargetWriteTime(work.lastTargetWriteTimeNew);
 
 		Main::setErrorContext(nullptr);
 	};
@@ -145,14 +197,65 @@ static void ncpMain()
 
 	const std::vector<std::string>& preBuildCmds = BuildConfig::getPreBuildCmds();
 
-	if (BuildConfig::getLastWriteTime() > RebuildConfig::getBuildConfigWriteTime() || Main::getDefines() != RebuildConfig::getDefines())
-		forceRebuild = true;
+	std::vector<std::unique_ptr<TargetWork>> targets;
 
 	if (BuildConfig::getBuildArm7())
-		doWorkOnTarget(false);
+		targets.push_back(prepareTarget(false));
 
 	if (BuildConfig::getBuildArm9())
-		doWorkOnTarget(true);
+		targets.push_back(prepareTarget(true));
+
+	// The sources of both targets are compiled by the workers, each target is linked
+	// and patched as soon as its own sources are done, while the sources of the
+	// other target may still be compiling.
+	std::vector<ObjMaker*> objMakers;
+	for (auto& target : targets)
+		objMakers.push_back(&target->objMaker);
+
+	if (!targets.empty())
+	{
+		Main::setErrorContext(targets.size() > 1 ?
+			"Could not compile the ARM7 and ARM9 targets." :
+			(targets[0]->isArm9 ? "Could not compile the ARM9 target." : "Could not compile the ARM7 target."));
+		ObjMaker::scheduleTargets(objMakers, scheduler, logger);
+		Main::setErrorContext(nullptr);
+	}
+
+	// The compiler output is shown by a caller task too, caller tasks run one at
+	// a time, so it never writes to the log while a target is being patched
+	std::vector<BuildScheduler::TaskID> allCompileTasks;
+	for (auto& target : targets)
+	{
+		const std::vector<BuildScheduler::TaskID>& compileTasks = target->objMaker.getCompileTasks();
+		allCompileTasks.insert(allCompileTasks.end(), compileTasks.begin(), compileTasks.end());
+	}
+	scheduler.addTask([&logger](){
+		if (logger.getActive())
+			logger.finish();
+	}, allCompileTasks, false);
+
+	for (auto& target : targets)
+	{
+		TargetWork* work = target.get();
+		scheduler.addTask([&patchTarget, work](){ patchTarget(*work); }, work->objMaker.getCompileTasks(), false);
+	}
+
+	// Only animates the progress, it keeps going while a target is patched
+	auto updateProgress = [&](){
+		logger.update();
+	};
+
+	try
+	{
+		scheduler.run(updateProgress);
+	}
+	catch (...)
+	{
+		// The compiler output is shown before the error
+		if (logger.getActive())
+			logger.finish();
+		throw;
+	}
 
 	RebuildConfig::setBuildConfigWriteTime(BuildConfig::getLastWriteTime());
 	RebuildConfig::setDefines(Main::getDefines());
@@ -179,9 +282,7 @@ static void runCommandList(const std::vector<std::string>& buildCmds, const char
 		oss << ANSI_bWHITE "[#" << i << "] " ANSI_bYELLOW << buildCmd << ANSI_RESET;
 		Log::info(oss.str());
 
-		fs::current_path(Main::getWorkPath());
-
-		int retcode = Process::start(buildCmd.c_str(), &std::cout);
+		int retcode = Process::start(buildCmd.c_str(), &std::cout, Main::getWorkPath().string().c_str());
 		if (retcode != 0)
 			throw ncp::exception("Process returned: " + std::to_string(retcode));
 		
@@ -191,6 +292,15 @@ static void runCommandList(const std::vector<std::string>& buildCmds, const char
 	Main::setErrorContext(nullptr);
 }
 
+static void printError(const std::exception& e)
+{
+	Log::out << OERROR;
+	if (Main::s_errorContext)
+		Log::out << Main::s_errorContext << "\n" << OREASON;
+	Log::out << e.what() << std::endl;
+	Main::s_errorContext = nullptr;
+}
+
 static std::filesystem::path fetchAppPath()
 {
 	// Copied from arclight.filesystem
@@ -313,6 +423,8 @@ int main(int argc, char* argv[])
 			return 0;
 		} else if ((strcmp(argv[i], "--verbose") == 0) || (strcmp(argv[i], "-v") == 0)) {
 			Main::s_verbose = true;
+		} else if (strcmp(argv[i], "--watch") == 0) {
+			Main::s_watch = true;
 		} else if (strcmp(argv[i], "--define") == 0) {
 			if (i + 1 < argc) {
 				Main::s_defines.push_back(argv[i + 1]);
@@ -331,18 +443,49 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	if (!Main::s_watch)
+	{
+		try
+		{
+			ncpMain(nullptr);
+		}
+		catch (std::exception& e)
+		{
+			printError(e);
+			return 1;
+		}
+
+		return 0;
+	}
+
+	// Every build runs in this process, a failed build is reported and the next change is waited for.
+	// The configuration and the binaries are loaded again by each build, which takes a few milliseconds.
 	try
 	{
-		ncpMain();
+		FileWatcher watcher;
+		while (true)
+		{
+			// The watches are kept while building, so a file saved meanwhile starts the next build
+			watcher.beginUpdate();
+
+			try
+			{
+				ncpMain(&watcher);
+			}
+			catch (std::exception& e)
+			{
+				printError(e);
+			}
+
+			watcher.endUpdate();
+
+			Log::info("Waiting for changes...");
+			watcher.waitForChange();
+		}
 	}
 	catch (std::exception& e)
 	{
-		Log::out << OERROR;
-		if (Main::s_errorContext)
-			Log::out << Main::s_errorContext << "\n" << OREASON;
-		Log::out << e.what() << std::endl;
+		printError(e);
 		return 1;
 	}
-
-	return 0;
 }
@@ -19,6 +19,9 @@ static const char* LoadErr7 = "Could not load ARM7.";
 static const char* LoadErr9 = "Could not load ARM9.";
 static const char* InvResn = "Invalid ARM| file.";
 
+// The secure area must stay uncompressed, it is read before the startup code runs.
+constexpr u32 SecureAreaSize = 0x4000;
+
 ArmBin::ArmBin() = default;
 
 void ArmBin::load(const fs::path& path, u32 entryAddr, u32 ramAddr, u32 autoLoadHookOff, bool isArm9)
@@ -194,6 +197,26 @@ void ArmBin::refreshAutoloadData()
 	}
 }
 
+bool ArmBin::compress(BLZ::CompressMode mode, BS::thread_pool& pool)
+{
+	// The startup code and the module params must be readable before decompression.
+	u32 rawSize = std::max<u32>(SecureAreaSize, m_moduleParamsOff + sizeof(ModuleParams));
+	rawSize = (rawSize + 3) & ~3;
+	if (m_bytes.size() <= rawSize)
+		return false;
+
+	std::vector<u8> staticData(m_bytes.begin() + rawSize, m_bytes.end());
+	std::vector<u8> compData = BLZ::compress(staticData, mode, pool);
+	if (compData.empty())
+		return false;
+
+	m_bytes.resize(rawSize);
+	m_bytes.insert(m_bytes.end(), compData.begin(), compData.end());
+
+	getModuleParams()->compStaticEnd = m_ramAddr + u32(m_bytes.size());
+	return true;
+}
+
 std::string ArmBin::getString(const std::string& str) const
 {
 	return Util::strRepl(str, '|', char('0' + (m_isArm9 ? 9 : 7)));
@@ -8,6 +8,7 @@
 #include "icodebin.hpp"
 
 #include "../types.hpp"
+#include "../blz.hpp"
 
 class ArmBin : public ICodeBin
 {
@@ -40,6 +41,7 @@ public:
 	void writeBytes(u32 address, const void* data, u32 size) override;
 
 	void refreshAutoloadData();
+	bool compress(BLZ::CompressMode mode, BS::thread_pool& pool);
 
 	[[nodiscard]] constexpr u32 getRamAddress() const { return m_ramAddr; }
 	[[nodiscard]] inline ModuleParams* getModuleParams() { return reinterpret_cast<ModuleParams*>(&((m_bytes.data())[m_moduleParamsOff])); }
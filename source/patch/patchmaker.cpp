@@ -1,14 +1,19 @@
 #include "patchmaker.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <functional>
 #include <iomanip>
 #include <sstream>
 #include <unordered_map>
+#include <future>
+
+#include <BS_thread_pool.hpp>
 
 #include "arenalofinder.hpp"
 
 #include "../elf.hpp"
+#include "../blz.hpp"
 
 #include "../main.hpp"
 #include "../log.hpp"
@@ -190,6 +195,205 @@ static u32 getPatchOverwriteAmount(const GenericPatchInfo* p)
 	return 4;
 }
 
+// The pool outlives the tasks' data, so every task is waited for before the first error is rethrown
+static void waitForAll(std::vector<std::future<void>>& futures)
+{
+	for (std::future<void>& future : futures)
+		future.wait();
+	for (std::future<void>& future : futures)
+		future.get();
+}
+
+struct ObjectScanCacheKey
+{
+	s64 writeTime;
+	u64 size;
+};
+
+// Everything an object contributes, merged in job order once all objects were scanned
+struct ObjectScanResult
+{
+	ObjectScanCacheKey cacheKey;
+	std::vector<std::unique_ptr<GenericPatchInfo>> patchInfo;
+	std::vector<std::unique_ptr<RtReplPatchInfo>> rtreplPatches;
+	std::vector<std::string> externSymbols;
+	std::vector<std::unique_ptr<SectionInfo>> overwriteCandidateSections;
+	bool hasNcpSet = false;
+	std::ostringstream log;
+};
+
+// The scan results of an object are stored next to it, and reused while the object is unchanged.
+constexpr u32 ObjectScanCacheVersion = 1;
+
+static fs::path getObjectScanCachePath(const fs::path& objPath)
+{
+	fs::path cachePath = objPath;
+	cachePath += ".ncpinfo";
+	return cachePath;
+}
+
+static ObjectScanCacheKey getObjectScanCacheKey(const fs::path& objPath)
+{
+	return ObjectScanCacheKey{
+		.writeTime = s64(fs::last_write_time(objPath).time_since_epoch().count()),
+		.size = u64(fs::file_size(objPath))
+	};
+}
+
+static bool loadObjectScanCache(const fs::path& objPath, const ObjectScanCacheKey& key, SourceFileJob* job, ObjectScanResult& result)
+{
+	fs::path cachePath = getObjectScanCachePath(objPath);
+	if (!fs::exists(cachePath))
+		return false;
+
+	std::ifstream inputFile(cachePath, std::ios::binary);
+	if (!inputFile.is_open())
+		return false;
+	std::vector<u8> data(fs::file_size(cachePath));
+	inputFile.read(reinterpret_cast<char*>(data.data()), std::streamsize(data.size()));
+	inputFile.close();
+
+	// Any mismatch or truncated data simply means that the object has to be scanned again
+	const u8* curDataPtr = data.data();
+	const u8* endDataPtr = curDataPtr + data.size();
+	bool valid = true;
+
+	auto read = [&]<typename T>(){
+		if (std::size_t(endDataPtr - curDataPtr) < sizeof(T))
+		{
+			valid = false;
+			return T();
+		}
+		T value = Util::read<T>(curDataPtr);
+		curDataPtr += sizeof(T);
+		return value;
+	};
+
+	auto readString = [&](){
+		u32 length = read.template operator()<u32>();
+		if (!valid || std::size_t(endDataPtr - curDataPtr) < length)
+		{
+			valid = false;
+			return std::string();
+		}
+		std::string str(reinterpret_cast<const char*>(curDataPtr), length);
+		curDataPtr += length;
+		return str;
+	};
+
+	if (read.template operator()<u32>() != ObjectScanCacheVersion ||
+		read.template operator()<s64>() != key.writeTime ||
+		read.template operator()<u64>() != key.size)
+		return false;
+
+	bool hasNcpSet = read.template operator()<u8>() != 0;
+
+	std::vector<std::unique_ptr<GenericPatchInfo>> patchInfo;
+	u32 patchCount = read.template operator()<u32>();
+	for (u32 i = 0; valid && i < patchCount; i++)
+	{
+		auto* p = new GenericPatchInfo();
+		patchInfo.emplace_back(p);
+		p->srcAddress = 0;
+		p->destAddress = read.template operator()<u32>();
+		p->destAddressOv = read.template operator()<s32>();
+		p->patchType = read.template operator()<u32>();
+		p->sectionIdx = read.template operator()<s32>();
+		p->sectionSize = read.template operator()<s32>();
+		p->isNcpSet = read.template operator()<u8>() != 0;
+		p->srcThumb = read.template operator()<u8>() != 0;
+		p->destThumb = read.template operator()<u8>() != 0;
+		p->symbol = readString();
+		p->srcAddressOv = p->patchType == PatchType::Over ? p->destAddressOv : job->region->destination;
+		p->job = job;
+	}
+
+	std::vector<std::unique_ptr<RtReplPatchInfo>> rtreplPatches;
+	u32 rtreplCount = read.template operator()<u32>();
+	for (u32 i = 0; valid && i < rtreplCount; i++)
+		rtreplPatches.emplace_back(new RtReplPatchInfo{ readString(), job });
+
+	std::vector<std::unique_ptr<SectionInfo>> sections;
+	u32 sectionCount = read.template operator()<u32>();
+	for (u32 i = 0; valid && i < sectionCount; i++)
+	{
+		std::string name = readString();
+		u32 size = read.template operator()<u32>();
+		u32 alignment = read.template operator()<u32>();
+		sections.emplace_back(new SectionInfo{
+			.name = std::move(name),
+			.size = size,
+			.job = job,
+			.alignment = alignment
+		});
+	}
+
+	std::string log = readString();
+
+	if (!valid || curDataPtr != endDataPtr)
+		return false;
+
+	result.patchInfo = std::move(patchInfo);
+	result.rtreplPatches = std::move(rtreplPatches);
+	result.overwriteCandidateSections = std::move(sections);
+	result.hasNcpSet = hasNcpSet;
+	result.log << log;
+	return true;
+}
+
+static void saveObjectScanCache(const fs::path& objPath, const ObjectScanCacheKey& key, const ObjectScanResult& result)
+{
+	std::vector<u8> data;
+
+	auto write = [&data]<typename T>(T value){
+		std::size_t pos = data.size();
+		data.resize(pos + sizeof(T));
+		Util::write<T>(&data[pos], value);
+	};
+
+	auto writeString = [&](const std::string& str){
+		write.template operator()<u32>(u32(str.length()));
+		data.insert(data.end(), str.begin(), str.end());
+	};
+
+	write.template operator()<u32>(ObjectScanCacheVersion);
+	write.template operator()<s64>(key.writeTime);
+	write.template operator()<u64>(key.size);
+	write.template operator()<u8>(result.hasNcpSet);
+
+	write.template operator()<u32>(u32(result.patchInfo.size()));
+	for (const auto& p : result.patchInfo)
+	{
+		write.template operator()<u32>(p->destAddress);
+		write.template operator()<s32>(p->destAddressOv);
+		write.template operator()<u32>(u32(p->patchType));
+		write.template operator()<s32>(p->sectionIdx);
+		write.template operator()<s32>(p->sectionSize);
+		write.template operator()<u8>(p->isNcpSet);
+		write.template operator()<u8>(p->srcThumb);
+		write.template operator()<u8>(p->destThumb);
+		writeString(p->symbol);
+	}
+
+	write.template operator()<u32>(u32(result.rtreplPatches.size()));
+	for (const auto& p : result.rtreplPatches)
+		writeString(p->symbol);
+
+	write.template operator()<u32>(u32(result.overwriteCandidateSections.size()));
+	for (const auto& section : result.overwriteCandidateSections)
+	{
+		writeString(section->name);
+		write.template operator()<u32>(u32(section->size));
+		write.template operator()<u32>(section->alignment);
+	}
+
+	writeString(result.log.str());
+
+	// Replaced as a whole, so an interrupted build never leaves a truncated cache behind,
+	// it is not synced since a damaged cache is rejected when loaded
+	Util::writeFileIfChanged(getObjectScanCachePath(objPath), data.data(), data.size(), false);
+}
+
 PatchMaker::PatchMaker() = default;
 PatchMaker::~PatchMaker() = default;
 
@@ -198,34 +402,48 @@ void PatchMaker::makeTarget(
 	const std::filesystem::path& targetWorkDir,
 	const std::filesystem::path& buildDir,
 	const HeaderBin& header,
-	std::vector<std::unique_ptr<SourceFileJob>>& srcFileJobs
+	std::vector<std::unique_ptr<SourceFileJob>>& srcFileJobs,
+	BS::thread_pool& pool
 	)
 {
 	m_target = &target;
 	m_targetWorkDir = &targetWorkDir;
 	m_buildDir = &buildDir;
 	m_header = &header;
+	m_pool = &pool;
 	m_srcFileJobs = &srcFileJobs;
 
+	m_backupDir = Main::getWorkPath() / BuildConfig::getBackupDir();
 	m_ldscriptPath = *m_buildDir / (m_target->getArm9() ? "ldscript9.x" : "ldscript7.x");
 	m_elfPath = *m_buildDir / (m_target->getArm9() ? "arm9.elf" : "arm7.elf");
+	m_linkInfoPath = *m_buildDir / (m_target->getArm9() ? "link9.bin" : "link7.bin");
 
 	if (m_srcFileJobs->empty())
 		throw ncp::exception("There are no source files to link.");
 
+	std::vector<u32>& patchedOverlays = m_target->getArm9() ?
+		RebuildConfig::getArm7PatchedOvs() :
+		RebuildConfig::getArm9PatchedOvs();
+
+	// Nothing is loaded, patched or saved if the ROM already holds the result of this build
+	bool anyRebuilt = std::any_of(m_srcFileJobs->begin(), m_srcFileJobs->end(),
+		[](const std::unique_ptr<SourceFileJob>& job){ return job->rebuild; });
+	u64 lastFingerprint = m_target->getArm9() ?
+		RebuildConfig::getArm9PatchFingerprint() :
+		RebuildConfig::getArm7PatchFingerprint();
+	if (!anyRebuilt && lastFingerprint != 0 && getPatchFingerprint(patchedOverlays) == lastFingerprint)
+	{
+		Log::info("The ROM is up to date, skipped patching.");
+		return;
+	}
+
 	createBuildDirectory();
 	createBackupDirectory();
 
+	// The overlays are only loaded once a patch goes to them
 	loadArmBin();
 	loadOverlayTableBin();
 
-	std::vector<u32>& patchedOverlays = m_target->getArm9() ?
-		RebuildConfig::getArm7PatchedOvs() :
-		RebuildConfig::getArm9PatchedOvs();
-
-	for (u32 ovID : patchedOverlays)
-		loadOverlayBin(ovID);
-
 	fetchNewcodeAddr();
 	gatherInfoFromObjects();
 	setupOverwriteRegions();
@@ -237,16 +455,110 @@ void PatchMaker::makeTarget(
 	applyPatchesToRom();
 	unloadElfFile();
 
+	// Overlays patched by the previous build that nothing goes to anymore get their backup back
+	std::vector<u32> overlaysToRestore;
+	for (u32 ovID : patchedOverlays)
+	{
+		if (ovID >= m_overlays.size() || m_overlays[ovID] == nullptr)
+			overlaysToRestore.push_back(ovID);
+	}
+
 	patchedOverlays.clear();
-	for (const auto& [id, ov] : m_loadedOverlays)
+	for (std::size_t ovID = 0; ovID < m_overlays.size(); ovID++)
+	{
+		if (m_overlays[ovID] != nullptr && m_overlays[ovID]->getDirty())
+			patchedOverlays.push_back(u32(ovID));
+	}
+
+	compressBinaries();
+
+	// The binaries are independent files, they are written by the workers of the build
+	std::vector<std::future<void>> saves;
+	saveOverlayBins(saves);
+	restoreOverlayBins(overlaysToRestore, saves);
+	saves.emplace_back(m_pool->submit([this](){ saveOverlayTableBin(); }));
+	saves.emplace_back(m_pool->submit([this](){ saveArmBin(); }));
+	waitForAll(saves);
+
+	{
+		std::ostringstream oss;
+		oss << "Saved the binaries, " << std::dec << m_bytesWritten << " bytes written to "
+			<< m_filesWritten << " files, " << m_filesUnchanged << " files were unchanged.";
+		Log::info(oss.str());
+	}
+
+	u64 fingerprint = getPatchFingerprint(patchedOverlays);
+	m_target->getArm9() ?
+		RebuildConfig::setArm9PatchFingerprint(fingerprint) :
+		RebuildConfig::setArm7PatchFingerprint(fingerprint);
+}
+
+// Covers everything the patched binaries are made from, and the binaries as they were written to the ROM,
+// so they are made again after any of it changed, including when the ROM was extracted again.
+constexpr u32 PatchFingerprintVersion = 1;
+
+u64 PatchMaker::getPatchFingerprint(const std::vector<u32>& patchedOverlays) const
+{
+	std::string fingerprint;
+
+	auto addValue = [&fingerprint]<typename T>(T value){
+		fingerprint.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	};
+
+	auto addFile = [&](const fs::path& path){
+		std::error_code ec;
+		s64 writeTime = s64(fs::last_write_time(path, ec).time_since_epoch().count());
+		if (ec)
+			writeTime = -1;
+		u64 size = u64(fs::file_size(path, ec));
+		if (ec)
+			size = u64(-1);
+		fingerprint += path.string();
+		fingerprint += '\0';
+		addValue(writeTime);
+		addValue(size);
+	};
+
+	addValue(PatchFingerprintVersion);
+	addValue(s64(BuildConfig::getLastWriteTime()));
+	addValue(s64(m_target->getLastWriteTime()));
+
+	// The objects that were not built again still have the write time read before building
+	for (const std::unique_ptr<SourceFileJob>& srcFileJob : *m_srcFileJobs)
 	{
-		if (ov->getDirty())
-			patchedOverlays.push_back(id);
+		fs::file_time_type objWriteTime = srcFileJob->objFileWriteTime;
+		if (srcFileJob->rebuild)
+		{
+			std::error_code ec;
+			objWriteTime = fs::last_write_time(srcFileJob->objFilePath, ec);
+		}
+		fingerprint += srcFileJob->objFilePath.string();
+		fingerprint += '\0';
+		addValue(s64(objWriteTime.time_since_epoch().count()));
 	}
 
-	saveOverlayBins();
-	saveOverlayTableBin();
-	saveArmBin();
+	if (!m_target->symbols.empty())
+		addFile(*m_targetWorkDir / m_target->symbols);
+	addFile(m_elfPath);
+	addFile(Main::getRomPath() / "header.bin");
+
+	const char* armBinName = m_target->getArm9() ? "arm9.bin" : "arm7.bin";
+	const char* ovtBinName = m_target->getArm9() ? "arm9ovt.bin" : "arm7ovt.bin";
+	std::string ovPrefix = m_target->getArm9() ? "overlay9" : "overlay7";
+
+	for (const fs::path& dir : { m_backupDir, Main::getRomPath() })
+	{
+		addFile(dir / armBinName);
+		addFile(dir / ovtBinName);
+		for (u32 ovID : patchedOverlays)
+		{
+			addValue(ovID);
+			addFile(dir / ovPrefix / (ovPrefix + "_" + std::to_string(ovID) + ".bin"));
+		}
+	}
+
+	u64 hash = Util::hash64(fingerprint.data(), fingerprint.size());
+	return hash != 0 ? hash : 1;
 }
 
 void PatchMaker::fetchNewcodeAddr()
@@ -325,23 +637,12 @@ void PatchMaker::fetchNewcodeAddr()
 
 void PatchMaker::gatherInfoFromObjects()
 {
-	fs::current_path(*m_targetWorkDir);
-
 	Log::info("Getting patches from objects...");
 
-	for (auto& srcFileJob : *m_srcFileJobs)
-	{
+	auto parseObject = [&](SourceFileJob* srcFileJob, ObjectScanResult& result){
 		const fs::path& objPath = srcFileJob->objFilePath;
-
-		if (Main::getVerbose())
-			Log::out << ANSI_bYELLOW << objPath.string() << ANSI_RESET << std::endl;
-
 		const BuildTarget::Region* region = srcFileJob->region;
 
-		std::vector<GenericPatchInfo*> patchInfoForThisObj;
-
-		if (!std::filesystem::exists(objPath))
-			throw ncp::file_error(objPath, ncp::file_error::find);
 		Elf32 elf;
 		if (!elf.load(objPath))
 			throw ncp::file_error(objPath, ncp::file_error::read);
@@ -366,13 +667,13 @@ void PatchMaker::gatherInfoFromObjects()
 			std::size_t patchType = Util::indexOf(patchTypeName, s_patchTypeNames, sizeof(s_patchTypeNames) / sizeof(char*));
 			if (patchType == -1)
 			{
-				Log::out << OWARN << "Found invalid patch type: " << patchTypeName << std::endl;
+				result.log << OWARN << "Found invalid patch type: " << patchTypeName << std::endl;
 				return;
 			}
 
 			if (patchType == PatchType::Over && sectionIdx == -1)
 			{
-				Log::out << OWARN << "\"over\" patch must be a section type patch: " << patchTypeName << std::endl;
+				result.log << OWARN << "\"over\" patch must be a section type patch: " << patchTypeName << std::endl;
 				return;
 			}
 
@@ -380,9 +681,9 @@ void PatchMaker::gatherInfoFromObjects()
 			{
 				if (sectionIdx != -1) // we do not want the labels, those are placeholders
 				{
-					m_rtreplPatches.emplace_back(new RtReplPatchInfo{
+					result.rtreplPatches.emplace_back(new RtReplPatchInfo{
 						/*.symbol = */std::string(symbolName),
-						/*.job = */srcFileJob.get()
+						/*.job = */srcFileJob
 					});
 				}
 				return;
@@ -420,7 +721,7 @@ void PatchMaker::gatherInfoFromObjects()
 			try {
 				destAddress = Util::addrToInt(std::string(addressName));
 			} catch (std::exception& e) {
-				Log::out << OWARN << "Found invalid address for patch: " << labelName << std::endl;
+				result.log << OWARN << "Found invalid address for patch: " << labelName << std::endl;
 				return;
 			}
 			if (forceThumb)
@@ -434,28 +735,17 @@ void PatchMaker::gatherInfoFromObjects()
 				std::string_view overlayName = labelName.substr(overlayNameStart, overlayNameEnd - overlayNameStart);
 				if (!overlayName.starts_with("ov"))
 				{
-					Log::out << OWARN << "Expected overlay definition in patch for: " << labelName << std::endl;
+					result.log << OWARN << "Expected overlay definition in patch for: " << labelName << std::endl;
 					return;
 				}
 				try {
 					destAddressOv = Util::addrToInt(std::string(overlayName.substr(2)));
 				} catch (std::exception& e) {
-					Log::out << OWARN << "Found invalid overlay for patch: " << labelName << std::endl;
+					result.log << OWARN << "Found invalid overlay for patch: " << labelName << std::endl;
 					return;
 				}
 			}
 
-			for (auto& region : m_target->regions)
-			{
-				if (region.destination == destAddressOv && region.mode != BuildTarget::Mode::Append)
-				{
-					std::ostringstream oss;
-					oss << OSTRa(symbolName) << " (" << OSTR(srcFileJob->srcFilePath.string())
-						<< ") cannot be applied to an overlay that is not in " << OSTRa("append") << " mode.";
-					throw ncp::exception(oss.str());
-				}
-			}
-
 			int srcAddressOv = patchType == PatchType::Over ? destAddressOv : region->destination;
 
 			auto* patchInfoEntry = new GenericPatchInfo({
@@ -470,11 +760,10 @@ void PatchMaker::gatherInfoFromObjects()
 				.srcThumb = bool(symbolAddr & 1),
 				.destThumb = bool(destAddress & 1),
 				.symbol = std::string(symbolName),
-				.job = srcFileJob.get()
+				.job = srcFileJob
 			});
 
-			patchInfoForThisObj.emplace_back(patchInfoEntry);
-			m_patchInfo.emplace_back(patchInfoEntry);
+			result.patchInfo.emplace_back(patchInfoEntry);
 		};
 
 		// Find patches in sections
@@ -485,10 +774,7 @@ void PatchMaker::gatherInfoFromObjects()
 				if (ncpSetSection == nullptr && sectionName.substr(5).starts_with("set"))
 				{
 					ncpSetSection = &section;
-					int dest = region->destination;
-					if (std::find(m_destWithNcpSet.begin(), m_destWithNcpSet.end(), dest) == m_destWithNcpSet.end())
-						m_destWithNcpSet.emplace_back(dest);
-					m_jobsWithNcpSet.emplace_back(srcFileJob.get());
+					result.hasNcpSet = true;
 					return false;
 				}
 				parseSymbol(sectionName, 0, int(sectionIdx), int(section.sh_size));
@@ -508,7 +794,7 @@ void PatchMaker::gatherInfoFromObjects()
 		[&](const Elf32_Sym& symbol, std::string_view symbolName){
 			if (ELF32_ST_TYPE(symbol.st_info) == STT_FUNC)
 			{
-				for (GenericPatchInfo* p : patchInfoForThisObj)
+				for (const auto& p : result.patchInfo)
 				{
 					// no need to check this condition because at this point all fetched patches are only section marked ones
 					/*if (p->sectionIdx != -1) // is patch instructed by section
@@ -579,13 +865,6 @@ void PatchMaker::gatherInfoFromObjects()
 			return false;
 		});
 
-		// Find functions that should be external (label marked)
-		for (GenericPatchInfo* p : patchInfoForThisObj)
-		{
-			if (p->sectionIdx == -1) // is patch instructed by label
-				m_externSymbols.emplace_back(p->symbol);
-		}
-
 		// Find sections suitable to place in overwrites
 		forEachElfSection(eh, sh_tbl, str_tbl,
 		[&](std::size_t sectionIdx, const Elf32_Shdr& section, std::string_view sectionName){
@@ -613,24 +892,101 @@ void PatchMaker::gatherInfoFromObjects()
 				auto* sectionInfo = new SectionInfo{
 					.name = std::string(sectionName),
 					.size = section.sh_size,
-					.job = srcFileJob.get(),
+					.job = srcFileJob,
 					.alignment = section.sh_addralign > 0 ? section.sh_addralign : 4
 				};
-				m_overwriteCandidateSections.emplace_back(sectionInfo);
+				result.overwriteCandidateSections.emplace_back(sectionInfo);
 			}
 			return false;
 		});
+	};
+
+	auto scanObject = [&](SourceFileJob* srcFileJob, ObjectScanResult& result){
+		const fs::path& objPath = srcFileJob->objFilePath;
+
+		if (!std::filesystem::exists(objPath))
+			throw ncp::file_error(objPath, ncp::file_error::find);
+
+		ObjectScanCacheKey cacheKey = getObjectScanCacheKey(objPath);
+		if (!loadObjectScanCache(objPath, cacheKey, srcFileJob, result))
+		{
+			parseObject(srcFileJob, result);
+			saveObjectScanCache(objPath, cacheKey, result);
+		}
+		result.cacheKey = cacheKey;
+
+		for (const auto& p : result.patchInfo)
+		{
+			for (auto& region : m_target->regions)
+			{
+				if (region.destination == p->destAddressOv && region.mode != BuildTarget::Mode::Append)
+				{
+					std::ostringstream oss;
+					oss << OSTRa(p->symbol) << " (" << OSTR(srcFileJob->srcFilePath.string())
+						<< ") cannot be applied to an overlay that is not in " << OSTRa("append") << " mode.";
+					throw ncp::exception(oss.str());
+				}
+			}
+		}
+
+		// Find functions that should be external (label marked)
+		for (const auto& p : result.patchInfo)
+		{
+			if (p->sectionIdx == -1) // is patch instructed by label
+				result.externSymbols.emplace_back(p->symbol);
+		}
+	};
+
+	std::size_t jobCount = m_srcFileJobs->size();
+	std::vector<ObjectScanResult> results(jobCount);
+	{
+		std::vector<std::future<void>> scans;
+		scans.reserve(jobCount);
+		for (std::size_t i = 0; i < jobCount; i++)
+		{
+			SourceFileJob* srcFileJob = (*m_srcFileJobs)[i].get();
+			ObjectScanResult& result = results[i];
+			scans.emplace_back(m_pool->submit([&scanObject, srcFileJob, &result](){ scanObject(srcFileJob, result); }));
+		}
+
+		// Errors are reported for the first failing object in job order
+		waitForAll(scans);
+	}
+
+	// The objects are linked as they were scanned, so their keys tell if the link is up to date
+	{
+		std::string fingerprint;
+		for (std::size_t i = 0; i < jobCount; i++)
+		{
+			const ObjectScanCacheKey& key = results[i].cacheKey;
+			fingerprint += (*m_srcFileJobs)[i]->objFilePath.string();
+			fingerprint += '\0';
+			fingerprint.append(reinterpret_cast<const char*>(&key.writeTime), sizeof(key.writeTime));
+			fingerprint.append(reinterpret_cast<const char*>(&key.size), sizeof(key.size));
+		}
+		m_objectsHash = Util::hash64(fingerprint.data(), fingerprint.size());
+	}
+
+	for (std::size_t i = 0; i < jobCount; i++)
+	{
+		SourceFileJob* srcFileJob = (*m_srcFileJobs)[i].get();
+		ObjectScanResult& result = results[i];
+
+		if (Main::getVerbose())
+			Log::out << ANSI_bYELLOW << srcFileJob->objFilePath.string() << ANSI_RESET << std::endl;
+
+		Log::out << result.log.str() << std::flush;
 
 		if (Main::getVerbose())
 		{
-			if (patchInfoForThisObj.empty())
+			if (result.patchInfo.empty())
 			{
 				Log::out << "NO PATCHES" << std::endl;
 			}
 			else
 			{
 				Log::out << "SRC_ADDR_OV, DST_ADDR, DST_ADDR_OV, PATCH_TYPE, SEC_IDX, SEC_SIZE, NCP_SET, SRC_THUMB, DST_THUMB, SYMBOL" << std::endl;
-				for (auto& p : patchInfoForThisObj)
+				for (auto& p : result.patchInfo)
 				{
 					Log::out <<
 						std::setw(11) << std::dec << p->srcAddressOv << "  " <<
@@ -646,7 +1002,21 @@ void PatchMaker::gatherInfoFromObjects()
 				}
 			}
 		}
+
+		std::move(result.patchInfo.begin(), result.patchInfo.end(), std::back_inserter(m_patchInfo));
+		std::move(result.rtreplPatches.begin(), result.rtreplPatches.end(), std::back_inserter(m_rtreplPatches));
+		std::move(result.externSymbols.begin(), result.externSymbols.end(), std::back_inserter(m_externSymbols));
+		std::move(result.overwriteCandidateSections.begin(), result.overwriteCandidateSections.end(), std::back_inserter(m_overwriteCandidateSections));
+
+		if (result.hasNcpSet)
+		{
+			int dest = srcFileJob->region->destination;
+			if (std::find(m_destWithNcpSet.begin(), m_destWithNcpSet.end(), dest) == m_destWithNcpSet.end())
+				m_destWithNcpSet.emplace_back(dest);
+			m_jobsWithNcpSet.emplace_back(srcFileJob);
+		}
 	}
+
 	if (Main::getVerbose())
 	{
 		if (m_externSymbols.empty())
@@ -833,7 +1203,6 @@ void PatchMaker::assignSectionsToOverwrites()
 
 void PatchMaker::createBuildDirectory()
 {
-	fs::current_path(Main::getWorkPath());
 	const fs::path& buildDir = *m_buildDir;
 	if (!fs::exists(buildDir))
 	{
@@ -848,8 +1217,7 @@ void PatchMaker::createBuildDirectory()
 
 void PatchMaker::createBackupDirectory()
 {
-	fs::current_path(Main::getWorkPath());
-	const fs::path& bakDir = BuildConfig::getBackupDir();
+	const fs::path& bakDir = m_backupDir;
 	if (!fs::exists(bakDir))
 	{
 		if (!fs::create_directories(bakDir))
@@ -873,6 +1241,20 @@ void PatchMaker::createBackupDirectory()
 	}
 }
 
+void PatchMaker::saveFile(const fs::path& path, const void* data, std::size_t size)
+{
+	std::size_t written = Util::writeFileIfChanged(path, data, size);
+	if (written != 0)
+	{
+		m_bytesWritten += written;
+		m_filesWritten++;
+	}
+	else
+	{
+		m_filesUnchanged++;
+	}
+}
+
 void PatchMaker::loadArmBin()
 {
 	bool isArm9 = m_target->getArm9();
@@ -893,10 +1275,9 @@ void PatchMaker::loadArmBin()
 		autoLoadListHookOff = m_header->arm7AutoLoadListHookOffset;
 	}
 
-	fs::current_path(Main::getWorkPath());
-
-	fs::path bakBinName = BuildConfig::getBackupDir() / binName;
+	fs::path bakBinName = m_backupDir / binName;
 
+	// The backup is stored decompressed, so only the first build ever has to decompress the binary.
 	m_arm = std::make_unique<ArmBin>();
 	if (fs::exists(bakBinName)) //has backup
 	{
@@ -904,11 +1285,9 @@ void PatchMaker::loadArmBin()
 	}
 	else //has no backup
 	{
-		fs::current_path(Main::getRomPath());
-		m_arm->load(binName, entryAddress, ramAddress, autoLoadListHookOff, isArm9);
+		m_arm->load(Main::getRomPath() / binName, entryAddress, ramAddress, autoLoadListHookOff, isArm9);
 		const std::vector<u8>& bytes = m_arm->data();
 
-		fs::current_path(Main::getWorkPath());
 		std::ofstream outputFile(bakBinName, std::ios::binary);
 		if (!outputFile.is_open())
 			throw ncp::file_error(bakBinName, ncp::file_error::write);
@@ -922,13 +1301,7 @@ void PatchMaker::saveArmBin()
 	const char* binName = m_target->getArm9() ? "arm9.bin" : "arm7.bin";
 
 	const std::vector<u8>& bytes = m_arm->data();
-
-	fs::current_path(Main::getRomPath());
-	std::ofstream outputFile(binName, std::ios::binary);
-	if (!outputFile.is_open())
-		throw ncp::file_error(binName, ncp::file_error::write);
-	outputFile.write(reinterpret_cast<const char*>(bytes.data()), std::streamsize(bytes.size()));
-	outputFile.close();
+	saveFile(Main::getRomPath() / binName, bytes.data(), bytes.size());
 }
 
 void PatchMaker::loadOverlayTableBin()
@@ -937,9 +1310,7 @@ void PatchMaker::loadOverlayTableBin()
 
 	const char* binName = m_target->getArm9() ? "arm9ovt.bin" : "arm7ovt.bin";
 
-	fs::current_path(Main::getWorkPath());
-
-	fs::path bakBinName = BuildConfig::getBackupDir() / binName;
+	fs::path bakBinName = m_backupDir / binName;
 
 	fs::path workBinName;
 	if (fs::exists(bakBinName)) //has backup
@@ -948,10 +1319,9 @@ void PatchMaker::loadOverlayTableBin()
 	}
 	else //has no backup
 	{
-		fs::current_path(Main::getRomPath());
-		if (!fs::exists(binName))
-			throw ncp::file_error(binName, ncp::file_error::find);
-		workBinName = binName;
+		workBinName = Main::getRomPath() / binName;
+		if (!fs::exists(workBinName))
+			throw ncp::file_error(workBinName, ncp::file_error::find);
 	}
 
 	uintmax_t fileSize = fs::file_size(workBinName);
@@ -968,41 +1338,35 @@ void PatchMaker::loadOverlayTableBin()
 
 	m_bakOvtEntries.resize(m_ovtEntries.size());
 	std::memcpy(m_bakOvtEntries.data(), m_ovtEntries.data(), m_ovtEntries.size() * sizeof(OvtEntry));
+
+	m_overlays.clear();
+	m_overlays.resize(overlayCount);
 }
 
 void PatchMaker::saveOverlayTableBin()
 {
-	auto saveOvtEntries = [](const std::vector<OvtEntry>& ovtEntries, const fs::path& filePath){
-		std::ofstream outputFile(filePath, std::ios::binary);
-		if (!outputFile.is_open())
-			throw ncp::file_error(filePath, ncp::file_error::write);
-		outputFile.write(reinterpret_cast<const char*>(ovtEntries.data()), ovtEntries.size() * sizeof(OvtEntry));
-		outputFile.close();
+	auto saveOvtEntries = [this](const std::vector<OvtEntry>& ovtEntries, const fs::path& filePath){
+		saveFile(filePath, ovtEntries.data(), ovtEntries.size() * sizeof(OvtEntry));
 	};
 
 	const char* binName = m_target->getArm9() ? "arm9ovt.bin" : "arm7ovt.bin";
 
 	if (m_bakOvtChanged)
-	{
-		fs::current_path(Main::getWorkPath());
-		saveOvtEntries(m_bakOvtEntries, BuildConfig::getBackupDir() / binName);
-	}
+		saveOvtEntries(m_bakOvtEntries, m_backupDir / binName);
 
-	fs::current_path(Main::getRomPath());
-	saveOvtEntries(m_ovtEntries, binName);
+	saveOvtEntries(m_ovtEntries, Main::getRomPath() / binName);
 }
 
 OverlayBin* PatchMaker::loadOverlayBin(std::size_t ovID)
 {
 	std::string prefix = m_target->getArm9() ? "overlay9" : "overlay7";
 
-	fs::current_path(Main::getWorkPath());
-
 	fs::path binName = fs::path(prefix) / (prefix + "_" + std::to_string(ovID) + ".bin");
-	fs::path bakBinName = BuildConfig::getBackupDir() / binName;
+	fs::path bakBinName = m_backupDir / binName;
 
 	OvtEntry& ovte = m_ovtEntries[ovID];
 
+	// Like the ARM binary, backups are stored decompressed and their backup table entry has no compression flag.
 	auto* overlay = new OverlayBin();
 	if (fs::exists(bakBinName)) //has backup
 	{
@@ -1011,8 +1375,7 @@ OverlayBin* PatchMaker::loadOverlayBin(std::size_t ovID)
 	}
 	else //has no backup
 	{
-		fs::current_path(Main::getRomPath());
-		overlay->load(binName, ovte.ramAddress, ovte.flag & OVERLAY_FLAG_COMP, ovID);
+		overlay->load(Main::getRomPath() / binName, ovte.ramAddress, ovte.flag & OVERLAY_FLAG_COMP, ovID);
 		ovte.flag = 0;
 		const std::vector<u8>& bytes = overlay->data();
 
@@ -1024,44 +1387,163 @@ OverlayBin* PatchMaker::loadOverlayBin(std::size_t ovID)
 		m_bakOvtChanged = true;
 	}
 
-	m_loadedOverlays.emplace(ovID, std::unique_ptr<OverlayBin>(overlay));
+	m_overlays[ovID].reset(overlay);
 	return overlay;
 }
 
 OverlayBin* PatchMaker::getOverlay(std::size_t ovID)
 {
-	for (auto& [id, ov] : m_loadedOverlays)
+	if (ovID >= m_overlays.size())
 	{
-		if (id == ovID)
-			return ov.get();
+		std::ostringstream oss;
+		oss << "Overlay " << std::dec << ovID << " does not exist, the overlay table has " << m_overlays.size() << " entries.";
+		throw ncp::exception(oss.str());
 	}
-	return loadOverlayBin(ovID);
+
+	OverlayBin* overlay = m_overlays[ovID].get();
+	return overlay != nullptr ? overlay : loadOverlayBin(ovID);
 }
 
-void PatchMaker::saveOverlayBins()
+void PatchMaker::saveOverlayBins(std::vector<std::future<void>>& saves)
 {
 	std::string prefix = m_target->getArm9() ? "overlay9" : "overlay7";
 
-	for (auto& [ovID, ov] : m_loadedOverlays)
+	for (std::size_t ovID = 0; ovID < m_overlays.size(); ovID++)
 	{
+		OverlayBin* overlay = m_overlays[ovID].get();
+		if (overlay == nullptr)
+			continue;
+
 		fs::path binName = fs::path(prefix) / (prefix + "_" + std::to_string(ovID) + ".bin");
 
-		auto saveOvData = [](const std::vector<u8>& ovData, const fs::path& ovFilePath){
-			std::ofstream outputFile(ovFilePath, std::ios::binary);
-			if (!outputFile.is_open())
-				throw ncp::file_error(ovFilePath, ncp::file_error::write);
-			outputFile.write(reinterpret_cast<const char*>(ovData.data()), std::streamsize(ovData.size()));
-			outputFile.close();
-		};
+		saves.emplace_back(m_pool->submit([this, overlay, binName](){
+			const std::vector<u8>& ovData = overlay->data();
+			saveFile(Main::getRomPath() / binName, ovData.data(), ovData.size());
+
+			const std::vector<u8>& bakData = overlay->backupData();
+			if (!bakData.empty())
+				saveFile(m_backupDir / binName, bakData.data(), bakData.size());
+		}));
+	}
+}
+
+void PatchMaker::restoreOverlayBins(const std::vector<u32>& ovIDs, std::vector<std::future<void>>& saves)
+{
+	std::string prefix = m_target->getArm9() ? "overlay9" : "overlay7";
+
+	for (u32 ovID : ovIDs)
+	{
+		fs::path binName = fs::path(prefix) / (prefix + "_" + std::to_string(ovID) + ".bin");
+		fs::path bakBinName = m_backupDir / binName;
+
+		// Without a backup the overlay in the ROM was never changed
+		if (ovID >= m_ovtEntries.size() || !fs::exists(bakBinName))
+			continue;
+
+		// The backup is stored decompressed, the file is copied without being loaded as an overlay
+		m_ovtEntries[ovID].flag = 0;
+
+		saves.emplace_back(m_pool->submit([this, binName, bakBinName](){
+			std::ifstream inputFile(bakBinName, std::ios::binary);
+			if (!inputFile.is_open())
+				throw ncp::file_error(bakBinName, ncp::file_error::read);
+			std::vector<u8> bytes(fs::file_size(bakBinName));
+			inputFile.read(reinterpret_cast<char*>(bytes.data()), std::streamsize(bytes.size()));
+			inputFile.close();
+
+			saveFile(Main::getRomPath() / binName, bytes.data(), bytes.size());
+		}));
+	}
+}
+
+void PatchMaker::compressBinaries()
+{
+	auto getRegionForDest = [&](int dest) -> const BuildTarget::Region* {
+		for (const BuildTarget::Region& region : m_target->regions)
+		{
+			if (region.destination == dest)
+				return &region;
+		}
+		return nullptr;
+	};
+
+	const BuildTarget::Region* armRegion = getRegionForDest(-1);
+	bool compressArm = armRegion != nullptr && armRegion->compress;
+	if (compressArm && !m_target->getArm9())
+	{
+		Log::out << OWARN << "Compressing the ARM7 binary is not supported, it will be saved uncompressed." << std::endl;
+		compressArm = false;
+	}
+
+	struct OverlayToCompress
+	{
+		std::size_t ovID;
+		OverlayBin* ov;
+		BLZ::CompressMode mode;
+	};
+
+	std::vector<OverlayToCompress> overlaysToCompress;
+	for (std::size_t ovID = 0; ovID < m_overlays.size(); ovID++)
+	{
+		OverlayBin* ov = m_overlays[ovID].get();
+		if (ov == nullptr)
+			continue;
+		const BuildTarget::Region* region = getRegionForDest(int(ovID));
+		if (region != nullptr && region->compress && !ov->data().empty())
+			overlaysToCompress.push_back({ ovID, ov, region->compressMode });
+	}
+
+	if (!compressArm && overlaysToCompress.empty())
+		return;
+
+	Log::info("Compressing the binaries...");
+
+	BS::thread_pool& pool = *m_pool;
+
+	std::vector<std::future<std::vector<u8>>> ovResults;
+	ovResults.reserve(overlaysToCompress.size());
+	for (const OverlayToCompress& entry : overlaysToCompress)
+		ovResults.emplace_back(pool.submit([entry](){ return BLZ::compress(entry.ov->data(), entry.mode); }));
+
+	// The ARM binary is by far the largest, so it is split into blocks that share the pool with the overlays.
+	// It is compressed from this thread, which only waits on the pool and can not starve the workers.
+	if (compressArm)
+	{
+		std::size_t armUncompSize = getArm()->data().size();
+		if (!getArm()->compress(armRegion->compressMode, pool))
+		{
+			Log::out << OWARN << "The ARM binary could not be compressed, it will be saved uncompressed." << std::endl;
+		}
+		else if (Main::getVerbose())
+		{
+			Log::out << OINFO << "Compressed ARM: "
+				<< std::dec << armUncompSize << " -> " << getArm()->data().size() << " bytes" << std::endl;
+		}
+	}
 
-		fs::current_path(Main::getRomPath());
-		saveOvData(ov->data(), binName);
+	for (std::size_t i = 0; i < overlaysToCompress.size(); i++)
+	{
+		const OverlayToCompress& entry = overlaysToCompress[i];
+		std::vector<u8> compData = ovResults[i].get();
 
-		if (!ov->backupData().empty())
+		OvtEntry& ovtEntry = m_ovtEntries[entry.ovID];
+		if (compData.empty())
 		{
-			fs::current_path(Main::getWorkPath());
-			saveOvData(ov->backupData(), BuildConfig::getBackupDir() / binName);
+			Log::out << OWARN << "Overlay " << std::dec << entry.ovID << " could not be compressed, it will be saved uncompressed." << std::endl;
+			ovtEntry.compressed = 0;
+			ovtEntry.flag &= ~OVERLAY_FLAG_COMP;
+			continue;
 		}
+
+		if (Main::getVerbose())
+		{
+			Log::out << OINFO << "Compressed overlay " << std::dec << entry.ovID << ": "
+				<< entry.ov->data().size() << " -> " << compData.size() << " bytes" << std::endl;
+		}
+
+		entry.ov->data() = std::move(compData);
+		ovtEntry.compressed = u32(entry.ov->data().size());
+		ovtEntry.flag |= OVERLAY_FLAG_COMP;
 	}
 }
 
@@ -1087,12 +1569,9 @@ void PatchMaker::createLinkerScript()
 
 	Log::out << OLINK << "Generating the linker script..." << std::endl;
 
-	fs::current_path(*m_targetWorkDir);
 	fs::path symbolsFile;
 	if (!m_target->symbols.empty())
-		symbolsFile = fs::absolute(m_target->symbols);
-
-	fs::current_path(Main::getWorkPath());
+		symbolsFile = *m_targetWorkDir / m_target->symbols;
 
 	std::vector<std::unique_ptr<LDSMemoryEntry>> memoryEntries;
 	memoryEntries.emplace_back(new LDSMemoryEntry{ "bin", 0, 0x100000 });
@@ -1223,7 +1702,7 @@ void PatchMaker::createLinkerScript()
 	if (!symbolsFile.empty())
 	{
 		o += "INCLUDE \"";
-		o += Util::relativeIfSubpath(symbolsFile).string();
+		o += Util::relativeIfSubpath(symbolsFile, Main::getWorkPath()).string();
 		o += "\"\n\n";
 	}
 	
@@ -1231,12 +1710,12 @@ void PatchMaker::createLinkerScript()
 	for (auto& srcFileJob : *m_srcFileJobs)
 	{
 		o += "\t\"";
-		o += Util::relativeIfSubpath(srcFileJob->objFilePath).string();
+		o += Util::relativeIfSubpath(srcFileJob->objFilePath, Main::getWorkPath()).string();
 		o += "\"\n";
 	}
 
 	o += ")\n\nOUTPUT (\"";
-	o += Util::relativeIfSubpath(m_elfPath).string();
+	o += Util::relativeIfSubpath(m_elfPath, Main::getWorkPath()).string();
 	o += "\")\n\nMEMORY {\n";
 
 	for (auto& memoryEntry : memoryEntries)
@@ -1273,7 +1752,7 @@ void PatchMaker::createLinkerScript()
 				section->name.starts_with(".ncp_hook"))
 				continue;
 
-			std::string objPath = Util::relativeIfSubpath(section->job->objFilePath).string();
+			std::string objPath = Util::relativeIfSubpath(section->job->objFilePath, Main::getWorkPath()).string();
 			o += "\t\t. = ALIGN(";
 			o += std::to_string(section->alignment);
 			o += ");\n\t\t\"";
@@ -1339,7 +1818,7 @@ void PatchMaker::createLinkerScript()
 			{
 				if (f->region == s->region)
 				{
-					std::string objPath = Util::relativeIfSubpath(f->objFilePath).string();
+					std::string objPath = Util::relativeIfSubpath(f->objFilePath, Main::getWorkPath()).string();
 					static const char* secIncs[] = {
 						"text",
 						"rodata",
@@ -1385,7 +1864,7 @@ void PatchMaker::createLinkerScript()
 			{
 				if (f->region == s->region)
 				{
-					std::string objPath = Util::relativeIfSubpath(f->objFilePath).string();
+					std::string objPath = Util::relativeIfSubpath(f->objFilePath, Main::getWorkPath()).string();
 					addSectionInclude(o, objPath, "bss");
 					addSectionInclude(o, objPath, "bss.*");
 				}
@@ -1427,7 +1906,7 @@ void PatchMaker::createLinkerScript()
 				if (j->region->destination == p)
 				{
 					o += "\t\t KEEP(\"";
-					o += Util::relativeIfSubpath(j->objFilePath).string();
+					o += Util::relativeIfSubpath(j->objFilePath, Main::getWorkPath()).string();
 					o += "\" (.ncp_set))\n\t"
 						 "} > ncp_set AT > bin\n\n";
 				}
@@ -1450,6 +1929,8 @@ void PatchMaker::createLinkerScript()
 		o += ")\n";
 	}
 
+	m_ldscriptHash = Util::hash64(o.data(), o.size());
+
 	// Output the file
 	std::ofstream outputFile(m_ldscriptPath);
 	if (!outputFile.is_open())
@@ -1472,30 +1953,98 @@ std::string PatchMaker::ldFlagsToGccFlags(std::string flags)
 	return flags;
 }
 
-void PatchMaker::linkElfFile()
+// Remembers what the ELF file was linked from, it is kept as long as nothing of that changes.
+constexpr u32 LinkInfoVersion = 1;
+
+u64 PatchMaker::getLinkHash(const std::string& linkCmd) const
 {
-	Log::out << OLINK << "Linking the ARM binary..." << std::endl;
+	std::string inputs;
+	inputs += linkCmd;
+	inputs += '\0';
+	inputs.append(reinterpret_cast<const char*>(&m_ldscriptHash), sizeof(m_ldscriptHash));
+	inputs.append(reinterpret_cast<const char*>(&m_objectsHash), sizeof(m_objectsHash));
+
+	// The symbols file is included by the linker script
+	if (!m_target->symbols.empty())
+	{
+		fs::path symbolsPath = *m_targetWorkDir / m_target->symbols;
+		std::error_code ec;
+		s64 writeTime = s64(fs::last_write_time(symbolsPath, ec).time_since_epoch().count());
+		u64 size = u64(fs::file_size(symbolsPath, ec));
+		inputs.append(reinterpret_cast<const char*>(&writeTime), sizeof(writeTime));
+		inputs.append(reinterpret_cast<const char*>(&size), sizeof(size));
+	}
+
+	return Util::hash64(inputs.data(), inputs.size());
+}
 
-	fs::current_path(Main::getWorkPath());
+bool PatchMaker::getElfIsUpToDate(u64 linkHash) const
+{
+	if (!fs::exists(m_linkInfoPath) || !fs::exists(m_elfPath))
+		return false;
+
+	std::ifstream inputFile(m_linkInfoPath, std::ios::binary);
+	if (!inputFile.is_open())
+		return false;
+	u8 data[28];
+	inputFile.read(reinterpret_cast<char*>(data), sizeof(data));
+	if (inputFile.gcount() != sizeof(data))
+		return false;
+	inputFile.close();
+
+	// The ELF file itself must also be the one that was linked
+	ObjectScanCacheKey elfKey = getObjectScanCacheKey(m_elfPath);
+	return Util::read<u32>(&data[0]) == LinkInfoVersion &&
+		Util::read<u64>(&data[4]) == linkHash &&
+		Util::read<s64>(&data[12]) == elfKey.writeTime &&
+		Util::read<u64>(&data[20]) == elfKey.size;
+}
+
+void PatchMaker::saveLinkInfo(u64 linkHash) const
+{
+	ObjectScanCacheKey elfKey = getObjectScanCacheKey(m_elfPath);
 
+	u8 data[28];
+	Util::write<u32>(&data[0], LinkInfoVersion);
+	Util::write<u64>(&data[4], linkHash);
+	Util::write<s64>(&data[12], elfKey.writeTime);
+	Util::write<u64>(&data[20], elfKey.size);
+
+	Util::writeFileIfChanged(m_linkInfoPath, data, sizeof(data), false);
+}
+
+void PatchMaker::linkElfFile()
+{
 	std::string ccmd;
 	ccmd.reserve(64);
 	ccmd += BuildConfig::getToolchain();
 	ccmd += "gcc -nostartfiles -Wl,--gc-sections,-T\"";
-	ccmd += Util::relativeIfSubpath(m_ldscriptPath).string();
+	ccmd += Util::relativeIfSubpath(m_ldscriptPath, Main::getWorkPath()).string();
 	ccmd += '\"';
 	std::string targetFlags = ldFlagsToGccFlags(m_target->ldFlags);
 	if (!targetFlags.empty())
 		ccmd += ',';
 	ccmd += targetFlags;
 
+	u64 linkHash = getLinkHash(ccmd);
+	if (getElfIsUpToDate(linkHash))
+	{
+		Log::out << OLINK << "The ARM binary is up to date, skipped linking." << std::endl;
+		return;
+	}
+
+	Log::out << OLINK << "Linking the ARM binary..." << std::endl;
+
 	std::ostringstream oss;
-	int retcode = Process::start(ccmd.c_str(), &oss);
+	// The paths in the linker script are relative to the work directory
+	int retcode = Process::start(ccmd.c_str(), &oss, Main::getWorkPath().string().c_str());
 	if (retcode != 0)
 	{
 		Log::out << oss.str() << std::endl;
 		throw ncp::exception("Could not link the ELF file.");
 	}
+
+	saveLinkInfo(linkHash);
 }
 
 void PatchMaker::gatherInfoFromElf()
@@ -1506,29 +2055,34 @@ void PatchMaker::gatherInfoFromElf()
 	auto sh_tbl = m_elf->getSectionHeaderTable();
 	auto str_tbl = m_elf->getSection<char>(sh_tbl[eh.e_shstrndx]);
 
+	// Index the patches by the name of the symbol they are waiting for,
+	// a patch is resolved by the first symbol that matches it
+	std::unordered_map<std::string, std::vector<GenericPatchInfo*>> patchesForSymbol;
+	for (auto& p : m_patchInfo)
+	{
+		if (p->sectionIdx != -1) // patch is section
+			patchesForSymbol[p->symbol.substr(1)].push_back(p.get());
+		else
+			patchesForSymbol[p->symbol].push_back(p.get());
+	}
+
 	// Update the patch info with new values
 	forEachElfSymbol(*m_elf, eh, sh_tbl,
 	[&](const Elf32_Sym& symbol, std::string_view symbolName){
-		for (auto& p : m_patchInfo)
+		if (!patchesForSymbol.empty())
 		{
-			if (p->sectionIdx != -1) // patch is section
+			auto it = patchesForSymbol.find(std::string(symbolName));
+			if (it != patchesForSymbol.end())
 			{
-				std::string_view nameAsLabel = std::string_view(p->symbol).substr(1);
-				if (nameAsLabel == symbolName)
-				{
-					p->srcAddress = symbol.st_value;
-					p->sectionIdx = symbol.st_shndx;
-					p->symbol = nameAsLabel;
-				}
-			}
-			else
-			{
-				// This must run before fetching ncp_set section, otherwise ncp_set srcAddr will be overwritten
-				if (p->symbol == symbolName)
+				for (GenericPatchInfo* p : it->second)
 				{
+					// This must run before fetching ncp_set section, otherwise ncp_set srcAddr will be overwritten
+					if (p->sectionIdx != -1) // patch is section
+						p->symbol = symbolName;
 					p->srcAddress = symbol.st_value;
 					p->sectionIdx = symbol.st_shndx;
 				}
+				patchesForSymbol.erase(it);
 			}
 		}
 		if (symbolName.starts_with("ncp_autogendata"))
@@ -1551,17 +2105,25 @@ void PatchMaker::gatherInfoFromElf()
 		return false;
 	});
 
+	std::unordered_map<std::string, std::vector<GenericPatchInfo*>> overPatchesForSection;
+	std::unordered_map<int, std::vector<GenericPatchInfo*>> ncpSetPatchesForDest;
+	for (auto& p : m_patchInfo)
+	{
+		if (p->patchType == PatchType::Over)
+			overPatchesForSection[p->symbol].push_back(p.get());
+		if (p->isNcpSet)
+			ncpSetPatchesForDest[p->srcAddressOv].push_back(p.get());
+	}
+
 	forEachElfSection(eh, sh_tbl, str_tbl,
 	[&](std::size_t sectionIdx, const Elf32_Shdr& section, std::string_view sectionName){
-		for (auto& p : m_patchInfo)
+		auto overIt = overPatchesForSection.find(std::string(sectionName));
+		if (overIt != overPatchesForSection.end())
 		{
-			if (p->patchType == PatchType::Over)
+			for (GenericPatchInfo* p : overIt->second)
 			{
-				if (p->symbol == sectionName)
-				{
-					p->srcAddress = section.sh_addr; // should be the same as the destination
-					p->sectionIdx = int(sectionIdx);
-				}
+				p->srcAddress = section.sh_addr; // should be the same as the destination
+				p->sectionIdx = int(sectionIdx);
 			}
 		}
 		if (sectionName.starts_with(".ncp_set"))
@@ -1579,50 +2141,72 @@ void PatchMaker::gatherInfoFromElf()
 				}
 			}
 
+			auto ncpSetIt = ncpSetPatchesForDest.find(srcAddrOv);
+			if (ncpSetIt == ncpSetPatchesForDest.end())
+				return false;
+
 			const char* sectionData = m_elf->getSection<char>(section);
 
-			for (auto& p : m_patchInfo)
+			for (GenericPatchInfo* p : ncpSetIt->second)
 			{
-				if (p->isNcpSet && p->srcAddressOv == srcAddrOv)
+				u32 dataOffset = p->srcAddress - section.sh_addr;
+				if (dataOffset + 4 > section.sh_size)
 				{
-					u32 dataOffset = p->srcAddress - section.sh_addr;
-					if (dataOffset + 4 > section.sh_size)
-					{
-						std::ostringstream oss;
-						oss << "Tried to read " << OSTR(sectionName) << " data out of bounds.";
-						throw ncp::exception(oss.str());
-					}
-					// ncp_set comes with the THUMB bit, we must clear it!
-					p->srcAddress = Util::read<u32>(&sectionData[dataOffset]) & ~1;
+					std::ostringstream oss;
+					oss << "Tried to read " << OSTR(sectionName) << " data out of bounds.";
+					throw ncp::exception(oss.str());
 				}
+				// ncp_set comes with the THUMB bit, we must clear it!
+				p->srcAddress = Util::read<u32>(&sectionData[dataOffset]) & ~1;
 			}
 		}
 		return false;
 	});
 
-	// Check if any overlapping patches exist
-	bool foundOverlapping = false;
-	for (std::size_t i = 0; i < m_patchInfo.size(); i++)
+	// Check if any overlapping patches exist, sweeping over the patches sorted by destination
+	std::vector<std::size_t> patchOrder(m_patchInfo.size());
+	for (std::size_t i = 0; i < patchOrder.size(); i++)
+		patchOrder[i] = i;
+	std::stable_sort(patchOrder.begin(), patchOrder.end(), [&](std::size_t i, std::size_t j){
+		const auto& a = m_patchInfo[i];
+		const auto& b = m_patchInfo[j];
+		if (a->destAddressOv != b->destAddressOv)
+			return a->destAddressOv < b->destAddressOv;
+		return a->destAddress < b->destAddress;
+	});
+
+	std::vector<std::pair<std::size_t, std::size_t>> overlappingPatches;
+	for (std::size_t k = 0; k < patchOrder.size(); k++)
+	{
+		auto& a = m_patchInfo[patchOrder[k]];
+		u32 aEnd = a->destAddress + getPatchOverwriteAmount(a.get());
+		for (std::size_t l = k + 1; l < patchOrder.size(); l++)
+		{
+			auto& b = m_patchInfo[patchOrder[l]];
+			if (a->destAddressOv != b->destAddressOv || b->destAddress >= aEnd)
+				break;
+			u32 bEnd = b->destAddress + getPatchOverwriteAmount(b.get());
+			if (Util::overlaps(a->destAddress, aEnd, b->destAddress, bEnd))
+				overlappingPatches.emplace_back(std::minmax(patchOrder[k], patchOrder[l]));
+		}
+	}
+
+	if (!overlappingPatches.empty())
 	{
-		auto& a = m_patchInfo[i];
-        for (std::size_t j = i + 1; j < m_patchInfo.size(); j++)
+		// Report in the same order as the patches were found
+		std::sort(overlappingPatches.begin(), overlappingPatches.end());
+		for (const auto& [i, j] : overlappingPatches)
 		{
+			auto& a = m_patchInfo[i];
 			auto& b = m_patchInfo[j];
-			if (a->destAddressOv != b->destAddressOv)
-				continue;
 			u32 aSz = getPatchOverwriteAmount(a.get());
 			u32 bSz = getPatchOverwriteAmount(b.get());
-			if (Util::overlaps(a->destAddress, a->destAddress + aSz, b->destAddress, b->destAddress + bSz))
-			{
-				Log::out << OERROR
-					<< OSTRa(a->symbol) << "[sz=" << aSz << "] (" << OSTR(a->job->srcFilePath.string()) << ") overlaps with "
-					<< OSTRa(b->symbol) << "[sz=" << bSz << "] (" << OSTR(b->job->srcFilePath.string()) << ")\n";
-				foundOverlapping = true;
-			}
-        }
-    }
-	if (foundOverlapping)
+			Log::out << OERROR
+				<< OSTRa(a->symbol) << "[sz=" << aSz << "] (" << OSTR(a->job->srcFilePath.string()) << ") overlaps with "
+				<< OSTRa(b->symbol) << "[sz=" << bSz << "] (" << OSTR(b->job->srcFilePath.string()) << ")\n";
+		}
 		throw ncp::exception("Overlapping patches were detected.");
+	}
 	
 	// Check that no patch is being written to an overwrite region
 	bool foundPatchInOverwrite = false;
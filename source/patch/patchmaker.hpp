@@ -1,10 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <vector>
 #include <filesystem>
+#include <future>
 #include <unordered_map>
 
+#include <BS_thread_pool.hpp>
+
 #include "../types.hpp"
 #include "../build/sourcefilejob.hpp"
 #include "../config/buildtarget.hpp"
@@ -31,7 +35,8 @@ public:
 		const std::filesystem::path& targetWorkDir,
 		const std::filesystem::path& buildDir,
 		const HeaderBin& header,
-		std::vector<std::unique_ptr<SourceFileJob>>& srcFileJobs
+		std::vector<std::unique_ptr<SourceFileJob>>& srcFileJobs,
+		BS::thread_pool& pool
 	);
 
 private:
@@ -39,9 +44,10 @@ private:
 	const std::filesystem::path* m_targetWorkDir;
 	const std::filesystem::path* m_buildDir;
 	const HeaderBin* m_header;
+	BS::thread_pool* m_pool;
 	std::vector<std::unique_ptr<SourceFileJob>>* m_srcFileJobs;
 	std::unique_ptr<ArmBin> m_arm;
-	std::unordered_map<std::size_t, std::unique_ptr<OverlayBin>> m_loadedOverlays;
+	std::vector<std::unique_ptr<OverlayBin>> m_overlays; // Indexed by overlay ID, only the loaded ones are set
 	std::vector<OvtEntry> m_ovtEntries;
 	std::vector<OvtEntry> m_bakOvtEntries;
 	bool m_bakOvtChanged = false;
@@ -52,8 +58,15 @@ private:
 	std::vector<std::string> m_externSymbols;
 	std::vector<std::unique_ptr<struct SectionInfo>> m_overwriteCandidateSections;
 	std::vector<std::unique_ptr<struct OverwriteRegionInfo>> m_overwriteRegions;
+	std::filesystem::path m_backupDir;
 	std::filesystem::path m_ldscriptPath;
 	std::filesystem::path m_elfPath;
+	std::filesystem::path m_linkInfoPath;
+	u64 m_ldscriptHash;
+	u64 m_objectsHash;
+	std::atomic<std::size_t> m_bytesWritten = 0;
+	std::atomic<std::size_t> m_filesWritten = 0;
+	std::atomic<std::size_t> m_filesUnchanged = 0;
 	std::unique_ptr<Elf32> m_elf;
 	std::unordered_map<int, u32> m_newcodeAddrForDest;
 	std::unordered_map<int, std::unique_ptr<NewcodePatch>> m_newcodeDataForDest;
@@ -62,10 +75,14 @@ private:
 
 	[[nodiscard]] inline ArmBin* getArm() const { return m_arm.get(); }
 
+	u64 getPatchFingerprint(const std::vector<u32>& patchedOverlays) const;
 	void fetchNewcodeAddr();
 	void gatherInfoFromObjects();
 	static std::string ldFlagsToGccFlags(std::string flags);
 	void linkElfFile();
+	u64 getLinkHash(const std::string& linkCmd) const;
+	bool getElfIsUpToDate(u64 linkHash) const;
+	void saveLinkInfo(u64 linkHash) const;
 	static u32 makeJumpOpCode(u32 opCode, u32 fromAddr, u32 toAddr);
 	static u32 makeBLXOpCode(u32 fromAddr, u32 toAddr);
 	static u32 makeThumbCallOpCode(bool exchange, u32 fromAddr, u32 toAddr);
@@ -79,12 +96,15 @@ private:
 	void createBuildDirectory();
 	void createBackupDirectory();
 	void loadArmBin();
+	void saveFile(const std::filesystem::path& path, const void* data, std::size_t size);
 	void saveArmBin();
 	void loadOverlayTableBin();
 	void saveOverlayTableBin();
 	OverlayBin* loadOverlayBin(std::size_t ovID);
 	OverlayBin* getOverlay(std::size_t ovID);
-	void saveOverlayBins();
+	void saveOverlayBins(std::vector<std::future<void>>& saves);
+	void restoreOverlayBins(const std::vector<u32>& ovIDs, std::vector<std::future<void>>& saves);
+	void compressBinaries();
 
     void createLinkerScript();
     void setupOverwriteRegions();
@@ -2,17 +2,105 @@
 
 #include <string>
 #include <stdexcept>
-#include <thread>
 #include <vector>
 
 #define BUFSIZE 4096
 
 #ifdef _WIN32
 
+void Process::splitArgs(std::string_view cmd, std::vector<std::string>& out)
+{
+	// A program parses its own command line on Windows, so the arguments are kept as
+	// they were written, quotes and backslashes included, and start() passes them on
+	// unchanged. Only the spaces between them are found here, following the same rules.
+	std::string arg;
+	bool inQuotes = false;
+	std::size_t backslashes = 0;
+
+	for (char c : cmd)
+	{
+		if (!inQuotes && (c == ' ' || c == '\t'))
+		{
+			if (!arg.empty())
+			{
+				out.push_back(std::move(arg));
+				arg.clear();
+			}
+			backslashes = 0;
+			continue;
+		}
+
+		// A quote after an odd number of backslashes is escaped
+		if (c == '"' && backslashes % 2 == 0)
+			inQuotes = !inQuotes;
+		backslashes = (c == '\\') ? backslashes + 1 : 0;
+		arg += c;
+	}
+
+	if (!arg.empty())
+		out.push_back(std::move(arg));
+}
+
+#else
+
+void Process::splitArgs(std::string_view cmd, std::vector<std::string>& out)
+{
+	std::string arg;
+	bool inArg = false;
+	char quote = 0;
+
+	for (std::size_t i = 0; i < cmd.length(); i++)
+	{
+		char c = cmd[i];
+		if (quote == '\'')
+		{
+			if (c == '\'')
+				quote = 0;
+			else
+				arg += c;
+		}
+		else if (quote == '"')
+		{
+			if (c == '"')
+				quote = 0;
+			else if (c == '\\' && i + 1 < cmd.length() && std::string_view("\\\"$`").find(cmd[i + 1]) != std::string_view::npos)
+				arg += cmd[++i];
+			else
+				arg += c;
+		}
+		else if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+		{
+			if (inArg)
+			{
+				out.push_back(std::move(arg));
+				arg.clear();
+				inArg = false;
+			}
+		}
+		else
+		{
+			inArg = true;
+			if (c == '\'' || c == '"')
+				quote = c;
+			else if (c == '\\' && i + 1 < cmd.length())
+				arg += cmd[++i];
+			else
+				arg += c;
+		}
+	}
+
+	if (inArg)
+		out.push_back(std::move(arg));
+}
+
+#endif
+
+#ifdef _WIN32
+
 #include <windows.h>
 #include <tchar.h>
 
-int Process::start(const char* cmd, std::ostream* out)
+int Process::start(const char* cmd, std::ostream* out, const char* workDir)
 {
 	HANDLE g_hChildStd_OUT_Rd = NULL;
 	HANDLE g_hChildStd_OUT_Wr = NULL;
@@ -54,7 +142,7 @@ int Process::start(const char* cmd, std::ostream* out)
 	siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
 
 	// Create the child process.
-	bSuccess = CreateProcess(NULL, szCmdline, NULL, NULL, TRUE, 0, NULL, NULL, &siStartInfo, &piProcInfo);
+	bSuccess = CreateProcess(NULL, szCmdline, NULL, NULL, TRUE, 0, NULL, (TCHAR*)workDir, &siStartInfo, &piProcInfo);
    
 	// If an error occurs, exit the application. 
 	if (!bSuccess)
@@ -103,6 +191,31 @@ int Process::start(const char* cmd, std::ostream* out)
 	return int(dwExitCode);
 }
 
+int Process::start(const std::vector<std::string>& args, std::ostream* out, const char* workDir)
+{
+	std::string cmd;
+	for (const std::string& arg : args)
+	{
+		if (!cmd.empty())
+			cmd += ' ';
+
+		// An argument with quotes of its own was written for the command line, see splitArgs()
+		if ((!arg.empty() && arg.find_first_of(" \t") == std::string::npos) || arg.find('"') != std::string::npos)
+		{
+			cmd += arg;
+			continue;
+		}
+
+		// Without quotes inside, only the backslashes before the closing quote have to be escaped
+		std::size_t backslashes = arg.length() - arg.find_last_not_of('\\') - 1;
+		cmd += '"';
+		cmd += arg;
+		cmd.append(backslashes, '\\');
+		cmd += '"';
+	}
+	return start(cmd.c_str(), out, workDir);
+}
+
 bool Process::exists(const char* app)
 {
 	char fullPath[MAX_PATH];
@@ -111,77 +224,128 @@ bool Process::exists(const char* app)
 
 #else
 
+#include <cerrno>
+#include <cstring>
 #include <stddef.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
 #include <sys/wait.h>
 #define SHELL "/bin/sh"
 
-int Process::start(const char* cmd, std::ostream* out)
+// posix_spawn_file_actions_addchdir_np is only available since glibc 2.29 and macOS 10.15
+#if defined(__APPLE__) || (defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29)))
+#define HAS_SPAWN_CHDIR 1
+#else
+#define HAS_SPAWN_CHDIR 0
+#endif
+
+extern char** environ;
+
+static int spawnProcess(const char* path, char* const* argv, bool searchPath, std::ostream* out, const char* workDir)
 {
+#if !HAS_SPAWN_CHDIR
+	// Without a spawn action to change the directory, a shell changes it before replacing itself with the program
+	std::vector<char*> cdArgv;
+	if (workDir)
+	{
+		cdArgv.push_back(const_cast<char*>(SHELL));
+		cdArgv.push_back(const_cast<char*>("-c"));
+		cdArgv.push_back(const_cast<char*>("cd \"$0\" && exec \"$@\""));
+		cdArgv.push_back(const_cast<char*>(workDir));
+		for (char* const* arg = argv; *arg; arg++)
+			cdArgv.push_back(*arg);
+		cdArgv.push_back(nullptr);
+
+		path = SHELL;
+		argv = cdArgv.data();
+		searchPath = false;
+	}
+#endif
+
+	// The pipe must not leak into children spawned by other threads,
+	// otherwise the end of the output would only be seen once those exit too
 	int pipefd[2];
+#ifdef __linux__
+	if (pipe2(pipefd, O_CLOEXEC) < 0)
+		throw std::runtime_error("Process pipe2(pipefd) failed");
+#else
 	if (pipe(pipefd) < 0)
 		throw std::runtime_error("Process pipe(pipefd) failed");
+	fcntl(pipefd[0], F_SETFD, FD_CLOEXEC);
+	fcntl(pipefd[1], F_SETFD, FD_CLOEXEC);
+#endif
 
-	int status;
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDOUT_FILENO); // Send stdout to the pipe
+	posix_spawn_file_actions_adddup2(&actions, pipefd[1], STDERR_FILENO); // Send stderr to the pipe
+#if HAS_SPAWN_CHDIR
+	if (workDir)
+		posix_spawn_file_actions_addchdir_np(&actions, workDir);
+#endif
 
-	pid_t pid = fork();
-	if (pid < 0)
-		throw std::runtime_error("Process fork() failed");
+	pid_t pid;
+	int err = searchPath ?
+		posix_spawnp(&pid, path, &actions, nullptr, argv, environ) :
+		posix_spawn(&pid, path, &actions, nullptr, argv, environ);
 
-	if (pid == 0) // Child
-	{
-		close(pipefd[0]); // Close the unused read end
+	posix_spawn_file_actions_destroy(&actions);
+	close(pipefd[1]); // Only the child writes to the pipe
 
-		dup2(pipefd[1], STDOUT_FILENO); // Send stdout to the pipe
-		dup2(pipefd[1], STDERR_FILENO); // Send stderr to the pipe
-		close(pipefd[1]);               // This descriptor is no longer needed
+	if (err != 0)
+	{
+		close(pipefd[0]);
+		if (out)
+			*out << path << ": " << std::strerror(err) << "\n";
+		return 127; // Same as the shell when a command can not be found
+	}
 
-		execl(SHELL, SHELL, "-c", cmd, NULL); // Execute the shell command
-		_exit(EXIT_FAILURE);
+	// The output ends when the child exits, so reading it all before waiting can not deadlock
+	char buffer[BUFSIZE];
+	while (true)
+	{
+		ssize_t len = read(pipefd[0], buffer, sizeof(buffer));
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+		if (out)
+			out->write(buffer, len);
 	}
-	else // Parent
+	close(pipefd[0]);
+
+	int status;
+	while (waitpid(pid, &status, 0) != pid)
 	{
-		close(pipefd[1]); // Close the unused write end
-
-		// Use a separate thread to read from the pipe to prevent deadlock
-		std::vector<char> output_buffer;
-		std::thread reader_thread([&]() {
-			char buffer[BUFSIZE];
-			ssize_t len;
-			while ((len = read(pipefd[0], buffer, sizeof(buffer))) > 0)
-			{
-				if (out)
-					out->write(buffer, len);
-				else
-				{
-					// Even if no output stream is provided, we need to consume the data
-					// to prevent the child process from blocking on writes
-					output_buffer.insert(output_buffer.end(), buffer, buffer + len);
-				}
-			}
-			close(pipefd[0]); // Close the read end
-		});
-		
-		// Wait for the child to complete
-		if (waitpid(pid, &status, 0) != pid)
-			status = -1;
-		else if (WIFEXITED(status))
-			status = WEXITSTATUS(status);
-		else
-			status = -1;
-		
-		// Wait for the reader thread to finish
-		reader_thread.join();
+		if (errno != EINTR)
+			return -1;
 	}
 
-	return status;
+	return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int Process::start(const char* cmd, std::ostream* out, const char* workDir)
+{
+	const char* argv[] = { SHELL, "-c", cmd, nullptr };
+	return spawnProcess(SHELL, const_cast<char* const*>(argv), false, out, workDir);
+}
+
+int Process::start(const std::vector<std::string>& args, std::ostream* out, const char* workDir)
+{
+	std::vector<char*> argv;
+	argv.reserve(args.size() + 1);
+	for (const std::string& arg : args)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(nullptr);
+
+	return spawnProcess(argv[0], argv.data(), true, out, workDir);
 }
 
 bool Process::exists(const char* app)
 {
-	std::string cmd = std::string("which ") + app;
-	return Process::start(cmd.c_str()) == 0;
+	return Process::start(std::vector<std::string>{ "which", app }) == 0;
 }
 
 #endif
@@ -1,9 +1,22 @@
 #pragma once
 
 #include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
 
 namespace Process
 {
-	int start(const char* cmd, std::ostream* out = nullptr);
+	// Runs a command through the shell, in workDir if given instead of the current directory.
+	int start(const char* cmd, std::ostream* out = nullptr, const char* workDir = nullptr);
+
+	// Runs a program directly, args[0] is searched in the PATH.
+	// On Windows the arguments are joined into one command line, those holding quotes are taken as written.
+	int start(const std::vector<std::string>& args, std::ostream* out = nullptr, const char* workDir = nullptr);
+
 	bool exists(const char* app);
+
+	// Splits a command line into arguments like a shell would, without any expansion.
+	// On Windows the arguments keep their quotes, the program removes them itself.
+	void splitArgs(std::string_view cmd, std::vector<std::string>& out);
 }
@@ -1,9 +1,18 @@
 #include "util.hpp"
 
+#include <cstdio>
+#include <fstream>
 #include <iomanip>
 #include <sstream>
 
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 #include "log.hpp"
+#include "except.hpp"
 
 namespace Util {
 
@@ -41,14 +50,14 @@ void printDataAsHex(const void* data, std::size_t size, std::size_t rowlen)
 	Log::out << std::flush;
 }
 
-std::filesystem::path relativeIfSubpath(const std::filesystem::path& path)
+std::filesystem::path relativeIfSubpath(const std::filesystem::path& path, const std::filesystem::path& base)
 {
     try
 	{
-        auto relative = std::filesystem::relative(path);
+        auto relative = std::filesystem::relative(path, base);
 		bool notSubpath = relative.string().starts_with("..");
 
-        return notSubpath ? path : std::filesystem::relative(path);
+        return notSubpath ? path : relative;
     }
 	catch (const std::filesystem::filesystem_error&)
 	{
@@ -56,4 +65,129 @@ std::filesystem::path relativeIfSubpath(const std::filesystem::path& path)
     }
 }
 
+// The XXH64 algorithm, fast enough to hash every source and header of a build
+std::uint64_t hash64(const void* data, std::size_t size, std::uint64_t seed)
+{
+	constexpr std::uint64_t P1 = 0x9E3779B185EBCA87ULL;
+	constexpr std::uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+	constexpr std::uint64_t P3 = 0x165667B19E3779F9ULL;
+	constexpr std::uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+	constexpr std::uint64_t P5 = 0x27D4EB2F165667C5ULL;
+
+	auto rotl = [](std::uint64_t x, int r){ return (x << r) | (x >> (64 - r)); };
+	auto round = [&](std::uint64_t acc, std::uint64_t input){ return rotl(acc + input * P2, 31) * P1; };
+	auto mergeRound = [&](std::uint64_t acc, std::uint64_t val){ return (acc ^ round(0, val)) * P1 + P4; };
+
+	const auto* p = static_cast<const std::uint8_t*>(data);
+	const std::uint8_t* end = p + size;
+	std::uint64_t h;
+
+	if (size >= 32)
+	{
+		std::uint64_t v1 = seed + P1 + P2;
+		std::uint64_t v2 = seed + P2;
+		std::uint64_t v3 = seed;
+		std::uint64_t v4 = seed - P1;
+		do
+		{
+			v1 = round(v1, read<std::uint64_t>(p));
+			v2 = round(v2, read<std::uint64_t>(p + 8));
+			v3 = round(v3, read<std::uint64_t>(p + 16));
+			v4 = round(v4, read<std::uint64_t>(p + 24));
+			p += 32;
+		} while (p <= end - 32);
+
+		h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+		h = mergeRound(h, v1);
+		h = mergeRound(h, v2);
+		h = mergeRound(h, v3);
+		h = mergeRound(h, v4);
+	}
+	else
+	{
+		h = seed + P5;
+	}
+
+	h += std::uint64_t(size);
+
+	for (; p + 8 <= end; p += 8)
+		h = rotl(h ^ round(0, read<std::uint64_t>(p)), 27) * P1 + P4;
+	if (p + 4 <= end)
+	{
+		h = rotl(h ^ (std::uint64_t(read<std::uint32_t>(p)) * P1), 23) * P2 + P3;
+		p += 4;
+	}
+	for (; p < end; p++)
+		h = rotl(h ^ (*p * P5), 11) * P1;
+
+	h ^= h >> 33;
+	h *= P2;
+	h ^= h >> 29;
+	h *= P3;
+	h ^= h >> 32;
+	return h;
+}
+
+std::size_t writeFileIfChanged(const std::filesystem::path& path, const void* data, std::size_t size, bool sync)
+{
+	namespace fs = std::filesystem;
+
+	// The size is compared first, the contents are only read when it matches
+	std::error_code ec;
+	if (fs::file_size(path, ec) == size && !ec)
+	{
+		// An empty file needs no comparing, and data may be null then
+		if (size == 0)
+			return 0;
+
+		std::ifstream inputFile(path, std::ios::binary);
+		if (inputFile.is_open())
+		{
+			std::vector<char> oldData(size);
+			inputFile.read(oldData.data(), std::streamsize(size));
+			if (inputFile.gcount() == std::streamsize(size) && std::memcmp(oldData.data(), data, size) == 0)
+				return 0;
+		}
+	}
+
+	fs::path tempPath = path;
+	tempPath += ".tmp";
+
+	// When syncing, the data is on the disk before the rename, otherwise a crash
+	// could leave an empty file in place of the old one
+#ifdef _WIN32
+	std::FILE* outputFile = _wfopen(tempPath.c_str(), L"wb");
+#else
+	std::FILE* outputFile = std::fopen(tempPath.c_str(), "wb");
+#endif
+	if (outputFile == nullptr)
+		throw ncp::file_error(tempPath, ncp::file_error::write);
+	bool written = (size == 0 || std::fwrite(data, 1, size, outputFile) == size) && std::fflush(outputFile) == 0;
+	if (sync)
+	{
+#ifdef _WIN32
+		written = written && _commit(_fileno(outputFile)) == 0;
+#else
+		written = written && fsync(fileno(outputFile)) == 0;
+#endif
+	}
+	written = std::fclose(outputFile) == 0 && written;
+	if (!written)
+	{
+		fs::remove(tempPath, ec);
+		throw ncp::file_error(tempPath, ncp::file_error::write);
+	}
+
+	fs::rename(tempPath, path, ec);
+	if (ec)
+	{
+		// Not every system replaces an existing file when renaming
+		fs::remove(path, ec);
+		fs::rename(tempPath, path, ec);
+		if (ec)
+			throw ncp::file_error(path, ncp::file_error::write);
+	}
+
+	return size;
+}
 }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <cstring>
 #include <ctime>
 #include <string>
@@ -95,6 +96,13 @@ std::string intToAddr(int in, int align, bool prefix = true);
 
 void printDataAsHex(const void* data, std::size_t size, std::size_t rowlen);
 
-std::filesystem::path relativeIfSubpath(const std::filesystem::path& path);
+std::filesystem::path relativeIfSubpath(const std::filesystem::path& path, const std::filesystem::path& base);
+
+std::uint64_t hash64(const void* data, std::size_t size, std::uint64_t seed = 0);
+
+// Replaces the file through a temporary one, so it is never left half written,
+// unless it already holds the same bytes. Returns how many bytes were written.
+// Without sync, a crash may still lose the file, for caches that are checked when loaded.
+std::size_t writeFileIfChanged(const std::filesystem::path& path, const void* data, std::size_t size, bool sync = true);
 
 }